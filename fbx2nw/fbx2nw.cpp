@@ -12,8 +12,13 @@
 #include "gr2_file.h"
 #include "log.h"
 #include "mdb_file.h"
+#include "mesh_decimator.h"
+#include "mesh_merger.h"
+#include "mesh_optimizer.h"
 #include "redirect_output_handle.h"
 #include "string_collection.h"
+#include "tangent_space.h"
+#include "vertex_welder.h"
 
 #ifdef _WIN32
 #include "granny2dll_handle.h"
@@ -30,6 +35,21 @@ struct Import_info {
 	// Without extension.
 	std::string output_path;
 	Output_type output_type;
+	/// Reorder faces and vertices of RIGD and SKIN packets for the GPU
+	/// vertex cache.
+	bool optimize_meshes = true;
+	/// Merge RIGD packets with the same material.
+	bool merge_packets = true;
+	/// Generate tangents and binormals even if the FBX has them.
+	bool generate_tangents = false;
+	/// Number of reduced LOD models saved next to the MDB. Each one has
+	/// half the faces of the previous one.
+	int lod_count = 0;
+	/// Fraction of the faces of the RIGD and SKIN packets kept in the
+	/// COL2/COL3 mesh derived from them, when the FBX doesn't have one. 0
+	/// doesn't derive the mesh.
+	float col2_ratio = 0;
+	float col3_ratio = 0;
 };
 
 const double time_step = 1 / 30.0;
@@ -85,6 +105,18 @@ static bool parse_args(int argc, char* argv[], Import_info& import_info)
 		if (argv[i][0] == '-') {
 			if (strcmp(argv[i], "-o") == 0 && i < argc - 1)
 				import_info.output_path = argv[++i];
+			else if (strcmp(argv[i], "-no-optimize") == 0)
+				import_info.optimize_meshes = false;
+			else if (strcmp(argv[i], "-no-merge") == 0)
+				import_info.merge_packets = false;
+			else if (strcmp(argv[i], "-tangents") == 0)
+				import_info.generate_tangents = true;
+			else if (strcmp(argv[i], "-lods") == 0 && i < argc - 1)
+				import_info.lod_count = atoi(argv[++i]);
+			else if (strcmp(argv[i], "-col2") == 0 && i < argc - 1)
+				import_info.col2_ratio = float(atof(argv[++i]));
+			else if (strcmp(argv[i], "-col3") == 0 && i < argc - 1)
+				import_info.col3_ratio = float(atof(argv[++i]));
 		}
 		else if (import_info.input_path.empty()) {
 			import_info.input_path = argv[i];
@@ -124,41 +156,6 @@ static bool parse_args(int argc, char* argv[], Import_info& import_info)
 	return true;
 }
 
-bool operator==(const MDB_file::Collision_mesh_vertex& v1,
-                const MDB_file::Collision_mesh_vertex& v2)
-{
-	return v1.position == v2.position && v1.normal == v2.normal &&
-	       v1.uvw == v2.uvw;
-}
-
-bool operator==(const MDB_file::Rigid_mesh_vertex &v1, const MDB_file::Rigid_mesh_vertex &v2)
-{
-	return v1.position == v2.position && v1.normal == v2.normal &&
-	       v1.tangent == v2.tangent && v1.binormal == v2.binormal &&
-	       v1.uvw == v2.uvw;
-}
-
-bool operator==(const MDB_file::Skin_vertex &v1, const MDB_file::Skin_vertex &v2)
-{
-	return v1.position == v2.position && v1.normal == v2.normal &&
-		v1.bone_weights[0] == v2.bone_weights[0] &&
-		v1.bone_weights[1] == v2.bone_weights[1] &&
-		v1.bone_weights[2] == v2.bone_weights[2] &&
-		v1.bone_weights[3] == v2.bone_weights[3] &&
-		v1.bone_indices[0] == v2.bone_indices[0] &&
-		v1.bone_indices[1] == v2.bone_indices[1] &&
-		v1.bone_indices[2] == v2.bone_indices[2] &&
-		v1.bone_indices[3] == v2.bone_indices[3] &&
-		v1.tangent == v2.tangent && v1.binormal == v2.binormal &&
-		v1.uvw == v2.uvw &&
-		v1.bone_count == v2.bone_count;
-}
-
-bool operator==(const MDB_file::Walk_mesh_vertex &v1, const MDB_file::Walk_mesh_vertex &v2)
-{
-	return v1.position == v2.position;
-}
-
 // Assumes the euler angles are from a right-handed system with y-axis up.
 FbxQuaternion euler_to_quaternion(const FbxVector4 &v)
 {
@@ -646,21 +643,9 @@ void import_material(MDB_file::Material& material, FbxMesh* mesh)
 	import_specular_power(material, mesh->GetNode(), m);
 }
 
-template <typename T, typename U>
-unsigned push_vertex(T& mesh, U& v)
-{
-	for(unsigned i = 0; i < mesh.verts.size(); ++i) {
-		if(mesh.verts[i] == v)
-			return i;
-	}
-
-	mesh.verts.push_back(v);
-
-	return mesh.verts.size() - 1;
-}
-
-void import_polygon(MDB_file::Collision_mesh& col_mesh, FbxMesh* mesh,
-                    int polygon_index)
+void import_polygon(MDB_file::Collision_mesh& col_mesh,
+                    Vertex_welder<MDB_file::Collision_mesh_vertex>& welder,
+                    FbxMesh* mesh, int polygon_index)
 {
 	if(mesh->GetPolygonSize(polygon_index) != 3) {
 		Log::error() << "Polygon is not a triangle.\n";
@@ -676,7 +661,7 @@ void import_polygon(MDB_file::Collision_mesh& col_mesh, FbxMesh* mesh,
 
 	for(int i = 0; i < 3; ++i)
 		face.vertex_indices[i] =
-		    push_vertex(col_mesh, poly_vertices[i]);
+		    welder.push(col_mesh.verts, poly_vertices[i]);
 
 	col_mesh.faces.push_back(face);
 }
@@ -698,8 +683,11 @@ void import_collision_mesh(MDB_file& mdb, FbxNode* node)
 	                                      : MDB_file::COL3);
 	set_packet_name(col_mesh->header.name, node->GetName());
 
+	Vertex_welder<MDB_file::Collision_mesh_vertex> welder;
+	welder.reserve(mesh->GetControlPointsCount());
+
 	for(int i = 0; i < mesh->GetPolygonCount(); ++i)
-		import_polygon(*col_mesh.get(), mesh, i);
+		import_polygon(*col_mesh.get(), welder, mesh, i);
 
 	if (col_mesh->verts.size() > max_vertices) {
 		Log::error()
@@ -750,7 +738,8 @@ uint16_t walk_mesh_face_flags(FbxMesh* mesh, int polygon_index)
 	return 0;
 }
 
-void import_polygon(MDB_file::Walk_mesh& walk_mesh, FbxMesh* mesh,
+void import_polygon(MDB_file::Walk_mesh& walk_mesh,
+	Vertex_welder<MDB_file::Walk_mesh_vertex>& welder, FbxMesh* mesh,
 	int polygon_index)
 {
 	if (mesh->GetPolygonSize(polygon_index) != 3) {
@@ -768,7 +757,8 @@ void import_polygon(MDB_file::Walk_mesh& walk_mesh, FbxMesh* mesh,
 		if (poly_vertices[i].position.z < -19.9f)
 			poly_vertices[i].position.z = -1000000.0f;
 
-		face.vertex_indices[i] = push_vertex(walk_mesh, poly_vertices[i]);
+		face.vertex_indices[i] =
+		    welder.push(walk_mesh.verts, poly_vertices[i]);
 	}
 
 	face.flags[0] = walk_mesh_face_flags(mesh, polygon_index);
@@ -789,8 +779,11 @@ void import_walk_mesh(MDB_file& mdb, FbxNode* node)
 	auto walk_mesh = make_unique<MDB_file::Walk_mesh>();
 	set_packet_name(walk_mesh->header.name, node->GetName());
 
+	Vertex_welder<MDB_file::Walk_mesh_vertex> welder;
+	welder.reserve(mesh->GetControlPointsCount());
+
 	for (int i = 0; i < mesh->GetPolygonCount(); ++i)
-		import_polygon(*walk_mesh, mesh, i);
+		import_polygon(*walk_mesh, welder, mesh, i);
 
 	if (walk_mesh->verts.size() > max_vertices) {
 		Log::error()
@@ -1058,7 +1051,8 @@ void import_helm(MDB_file& mdb, FbxNode* node)
 	mdb.add_packet(move(helm));
 }
 
-void import_polygon(MDB_file::Rigid_mesh& rigid_mesh, FbxMesh* mesh,
+void import_polygon(MDB_file::Rigid_mesh& rigid_mesh,
+	Vertex_welder<MDB_file::Rigid_mesh_vertex>& welder, FbxMesh* mesh,
 	int polygon_index)
 {
 	if(mesh->GetPolygonSize(polygon_index) != 3) {
@@ -1077,7 +1071,7 @@ void import_polygon(MDB_file::Rigid_mesh& rigid_mesh, FbxMesh* mesh,
 
 	for(int i = 0; i < 3; ++i)
 		face.vertex_indices[i] =
-		    push_vertex(rigid_mesh, poly_vertices[i]);
+		    welder.push(rigid_mesh.verts, poly_vertices[i]);
 
 	rigid_mesh.faces.push_back(face);
 }
@@ -1132,12 +1126,25 @@ bool validate_rigid_mesh(FbxMesh* mesh)
 		Log::error() << "There is no normal vector information.\n";
 		return false;
 	}
-	else if (mesh->GetElementTangentCount() == 0) {
-		Log::error() << "There is no tangent vector information.\n";
-		return false;
-	}
-	else if (mesh->GetElementBinormalCount() == 0) {
-		Log::error() << "There is no binormal vector information.\n";
+
+	return true;
+}
+
+// Generates tangents and binormals if requested, or if the FBX doesn't
+// have them.
+template <typename T>
+static bool import_tangent_space(const Import_info& import_info, T& mdb_mesh,
+                                 FbxMesh* mesh)
+{
+	if (!import_info.generate_tangents &&
+	    mesh->GetElementTangentCount() > 0 &&
+	    mesh->GetElementBinormalCount() > 0)
+		return true;
+
+	cout << "  Generating tangents and binormals\n";
+
+	if (!generate_tangents(mdb_mesh)) {
+		Log::error() << "Unable to generate tangents and binormals.\n";
 		return false;
 	}
 
@@ -1174,7 +1181,21 @@ void import_user_properties(FbxNode* node, MDB_file::Material& material)
 	                     MDB_file::PROJECTED_TEXTURES);
 }
 
-void import_rigid_mesh(MDB_file& mdb, FbxNode* node)
+template <typename T>
+static void optimize_packet(const Import_info& import_info, T& mesh)
+{
+	if (!import_info.optimize_meshes)
+		return;
+
+	float acmr_before = acmr(mesh.faces, mesh.verts.size());
+	optimize_mesh(mesh);
+	float acmr_after = acmr(mesh.faces, mesh.verts.size());
+
+	cout << "  ACMR: " << acmr_before << " -> " << acmr_after << endl;
+}
+
+void import_rigid_mesh(MDB_file& mdb, FbxNode* node,
+                       const Import_info& import_info)
 {
 	auto mesh = node->GetMesh();
 
@@ -1193,8 +1214,14 @@ void import_rigid_mesh(MDB_file& mdb, FbxNode* node)
 
 	import_material(rigid_mesh->header.material, mesh);
 
+	Vertex_welder<MDB_file::Rigid_mesh_vertex> welder;
+	welder.reserve(mesh->GetControlPointsCount());
+
 	for(int i = 0; i < mesh->GetPolygonCount(); ++i)
-		import_polygon(*rigid_mesh.get(), mesh, i);
+		import_polygon(*rigid_mesh.get(), welder, mesh, i);
+
+	if (!import_tangent_space(import_info, *rigid_mesh, mesh))
+		return;
 
 	if (rigid_mesh->verts.size() > max_vertices) {
 		Log::error()
@@ -1206,6 +1233,8 @@ void import_rigid_mesh(MDB_file& mdb, FbxNode* node)
 
 	import_user_properties(node, rigid_mesh->header.material);
 
+	optimize_packet(import_info, *rigid_mesh);
+
 	mdb.add_packet(move(rigid_mesh));
 }
 
@@ -1249,7 +1278,8 @@ FbxNode* skeleton_node(FbxMesh* mesh)
 	return skeleton_node(cluster->GetLink());
 }
 
-void import_polygon(MDB_file::Skin& skin, Fbx_bones& fbx_bones, FbxMesh* mesh,
+void import_polygon(MDB_file::Skin& skin, Fbx_bones& fbx_bones,
+	Vertex_welder<MDB_file::Skin_vertex>& welder, FbxMesh* mesh,
 	int polygon_index)
 {
 	if (mesh->GetPolygonSize(polygon_index) != 3) {
@@ -1269,7 +1299,7 @@ void import_polygon(MDB_file::Skin& skin, Fbx_bones& fbx_bones, FbxMesh* mesh,
 
 	for (int i = 0; i < 3; ++i)
 		face.vertex_indices[i] =
-		push_vertex(skin, poly_vertices[i]);
+		    welder.push(skin.verts, poly_vertices[i]);
 
 	skin.faces.push_back(face);
 }
@@ -1307,7 +1337,7 @@ void print_vertices(MDB_file::Skin& skin)
 	}
 }
 
-void import_skin(MDB_file& mdb, FbxNode* node)
+void import_skin(MDB_file& mdb, FbxNode* node, const Import_info& import_info)
 {
 	auto mesh = node->GetMesh();
 
@@ -1333,8 +1363,14 @@ void import_skin(MDB_file& mdb, FbxNode* node)
 	Fbx_bones fbx_bones;
 	gather_fbx_bones(skel_node->GetChild(0), fbx_bones);
 
+	Vertex_welder<MDB_file::Skin_vertex> welder;
+	welder.reserve(mesh->GetControlPointsCount());
+
 	for (int i = 0; i < mesh->GetPolygonCount(); ++i)
-		import_polygon(*skin.get(), fbx_bones, mesh, i);
+		import_polygon(*skin.get(), fbx_bones, welder, mesh, i);
+
+	if (!import_tangent_space(import_info, *skin, mesh))
+		return;
 
 	if (skin->verts.size() > max_vertices) {
 		Log::error()
@@ -1348,10 +1384,13 @@ void import_skin(MDB_file& mdb, FbxNode* node)
 
 	print_vertices(*skin);
 
+	optimize_packet(import_info, *skin);
+
 	mdb.add_packet(move(skin));
 }
 
-void import_meshes(MDB_file& mdb, FbxNode* node)
+void import_meshes(MDB_file& mdb, FbxNode* node,
+                   const Import_info& import_info)
 {
 	if (ends_with(node->GetName(), "_C2"))
 		import_collision_mesh(mdb, node);
@@ -1366,12 +1405,12 @@ void import_meshes(MDB_file& mdb, FbxNode* node)
 	else if (is_helm_packet(node))
 		import_helm(mdb, node);
 	else if (skin(node))
-		import_skin(mdb, node);
+		import_skin(mdb, node, import_info);
 	else if (!starts_with(node->GetName(), "COLS"))
-		import_rigid_mesh(mdb, node);
+		import_rigid_mesh(mdb, node, import_info);
 
 	for (int i = 0; i < node->GetChildCount(); ++i)
-		import_meshes(mdb, node->GetChild(i));
+		import_meshes(mdb, node->GetChild(i), import_info);
 }
 
 void import_meshes(MDB_file& mdb, FbxScene* scene)
@@ -2528,22 +2567,234 @@ static void import_collision_spheres(MDB_file& mdb, FbxScene* scene)
 		mdb.add_packet(move(cs));
 }
 
-void import_models(FbxScene* scene, const char* filename)
+// Returns the number of packets drawn by the game.
+static uint32_t draw_call_count(const MDB_file& mdb)
+{
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < mdb.packet_count(); ++i) {
+		auto packet = mdb.peek_packet(i);
+		if (packet && (packet->type == MDB_file::RIGD ||
+		               packet->type == MDB_file::SKIN))
+			++count;
+	}
+
+	return count;
+}
+
+static void merge_packets(MDB_file& mdb, const Import_info& import_info)
+{
+	if (!import_info.merge_packets)
+		return;
+
+	auto draw_calls = draw_call_count(mdb);
+
+	std::vector<uint32_t> merged_into;
+	if (merge_rigid_meshes(mdb, max_vertices, &merged_into) == 0)
+		return;
+
+	cout << "\nMerged RIGD packets with the same material\n";
+	cout << "  Draw calls: " << draw_calls << " -> "
+	     << draw_call_count(mdb) << endl;
+
+	// The faces of the appended packets follow each other, so the
+	// vertex cache order is lost at each seam.
+	for (auto i : merged_into) {
+		auto rm = static_cast<MDB_file::Rigid_mesh*>(mdb.packet(i));
+		optimize_packet(import_info, *rm);
+	}
+}
+
+static bool has_packet(const MDB_file& mdb, MDB_file::Packet_type type)
+{
+	for (uint32_t i = 0; i < mdb.packet_count(); ++i) {
+		auto packet = mdb.peek_packet(i);
+		if (packet && packet->type == type)
+			return true;
+	}
+
+	return false;
+}
+
+// Appends the faces of a mesh to a collision mesh being built, as three
+// indices per face. The indices are 32-bit until the vertex count is
+// checked.
+template <typename T>
+static void append_collision_faces(MDB_file::Collision_mesh& col_mesh,
+                                   std::vector<uint32_t>& indices,
+                                   Vertex_welder<MDB_file::Collision_mesh_vertex>& welder,
+                                   const T& mesh)
+{
+	for (auto& face : mesh.faces) {
+		// Only positions are welded, so seams of the render mesh don't
+		// restrict the decimation. Normals are computed afterwards.
+		for (int i = 0; i < 3; ++i) {
+			MDB_file::Collision_mesh_vertex v = {};
+			v.position = mesh.verts[face.vertex_indices[i]].position;
+			indices.push_back(welder.push(col_mesh.verts, v));
+		}
+	}
+}
+
+static void compute_normals(MDB_file::Collision_mesh& col_mesh)
+{
+	for (auto& face : col_mesh.faces) {
+		auto& p0 = col_mesh.verts[face.vertex_indices[0]].position;
+		auto& p1 = col_mesh.verts[face.vertex_indices[1]].position;
+		auto& p2 = col_mesh.verts[face.vertex_indices[2]].position;
+		auto n = cross(p1 - p0, p2 - p0);
+
+		for (int i = 0; i < 3; ++i) {
+			auto& v = col_mesh.verts[face.vertex_indices[i]];
+			v.normal = v.normal + n;
+		}
+	}
+
+	for (auto& v : col_mesh.verts)
+		v.normal = normalize(v.normal);
+}
+
+// Builds a COL2/COL3 mesh from the RIGD and SKIN packets of the MDB.
+static void derive_collision_mesh(MDB_file& mdb, MDB_file::Packet_type type,
+                                  float ratio, const Import_info& import_info)
+{
+	if (ratio <= 0 || has_packet(mdb, type))
+		return;
+
+	auto col_mesh = make_unique<MDB_file::Collision_mesh>(type);
+	string name = path(import_info.output_path).stem().string() +
+	              (type == MDB_file::COL2 ? "_C2" : "_C3");
+
+	cout << "Deriving " << (type == MDB_file::COL2 ? "COL2" : "COL3")
+	     << ": " << name << endl;
+
+	set_packet_name(col_mesh->header.name, name.c_str());
+
+	Vertex_welder<MDB_file::Collision_mesh_vertex> welder;
+	std::vector<uint32_t> indices;
+
+	for (uint32_t i = 0; i < mdb.packet_count(); ++i) {
+		auto packet = mdb.packet(i);
+		if (!packet)
+			continue;
+
+		if (packet->type == MDB_file::RIGD)
+			append_collision_faces(
+			    *col_mesh, indices, welder,
+			    *static_cast<MDB_file::Rigid_mesh*>(packet));
+		else if (packet->type == MDB_file::SKIN)
+			append_collision_faces(*col_mesh, indices, welder,
+			                       *static_cast<MDB_file::Skin*>(packet));
+	}
+
+	if (indices.empty())
+		return;
+
+	// The collision mesh is optional, so the model is still generated
+	// without it.
+	if (col_mesh->verts.size() > max_vertices) {
+		Log::warning()
+		    << "Derived collision mesh has " << col_mesh->verts.size()
+		    << " vertices, but the maximum supported is "
+		    << max_vertices << ". It's not generated.\n";
+		return;
+	}
+
+	col_mesh->faces.resize(indices.size() / 3);
+	for (size_t i = 0; i < col_mesh->faces.size(); ++i)
+		for (int j = 0; j < 3; ++j)
+			col_mesh->faces[i].vertex_indices[j] =
+			    uint16_t(indices[i * 3 + j]);
+
+	size_t face_count = col_mesh->faces.size();
+	decimate_mesh(*col_mesh, size_t(face_count * min(ratio, 1.0f)));
+	compute_normals(*col_mesh);
+
+	cout << "  Faces: " << face_count << " -> " << col_mesh->faces.size()
+	     << endl;
+
+	mdb.add_packet(move(col_mesh));
+}
+
+template <typename T>
+static void decimate_packet(const Import_info& import_info, T& mesh,
+                            float ratio)
+{
+	size_t face_count = mesh.faces.size();
+	decimate_mesh(mesh, size_t(face_count * ratio));
+
+	cout << "  " << string(mesh.header.name, strnlen(mesh.header.name, 32))
+	     << " faces: " << face_count << " -> " << mesh.faces.size()
+	     << endl;
+
+	optimize_packet(import_info, mesh);
+}
+
+// Saves reduced copies of the RIGD and SKIN packets as <output>_L01.mdb,
+// <output>_L02.mdb, ...
+static void save_lods(MDB_file& mdb, const Import_info& import_info)
+{
+	auto data = mdb.save_to_mem();
+
+	for (int level = 1; level <= import_info.lod_count; ++level) {
+		MDB_file lod(data.data(), data.size());
+		if (!lod) {
+			Log::error() << "Cannot generate LOD " << level << endl;
+			return;
+		}
+
+		float ratio = 1.0f / float(1 << level);
+
+		cout << "\nGenerating LOD " << level << endl;
+
+		for (uint32_t i = 0; i < lod.packet_count(); ++i) {
+			auto packet = lod.packet(i);
+			if (!packet)
+				continue;
+
+			if (packet->type == MDB_file::RIGD)
+				decimate_packet(
+				    import_info,
+				    *static_cast<MDB_file::Rigid_mesh*>(packet), ratio);
+			else if (packet->type == MDB_file::SKIN)
+				decimate_packet(import_info,
+				                *static_cast<MDB_file::Skin*>(packet),
+				                ratio);
+		}
+
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "_L%02d", level);
+
+		string output_filename =
+		    import_info.output_path + suffix + ".mdb";
+		lod.save(output_filename.c_str());
+		cout << "Output is " << output_filename << endl;
+	}
+}
+
+void import_models(FbxScene* scene, const Import_info& import_info)
 {
 	auto old_error_count = Log::error_count;
 
 	MDB_file mdb;
 
-	import_meshes(mdb, scene);
+	import_meshes(mdb, scene, import_info);
 	import_collision_spheres(mdb, scene);
+	merge_packets(mdb, import_info);
+	derive_collision_mesh(mdb, MDB_file::COL2, import_info.col2_ratio,
+	                      import_info);
+	derive_collision_mesh(mdb, MDB_file::COL3, import_info.col3_ratio,
+	                      import_info);
 
 	if (Log::error_count > old_error_count) {
 		Log::error() << "MDB not generated due to errors found during the conversion.\n";
 	}
 	else if (mdb.packet_count() > 0) {
-		string output_filename = string(filename) + ".mdb";
+		string output_filename = import_info.output_path + ".mdb";
 		mdb.save(output_filename.c_str());
 		cout << "\nOutput is " << output_filename << endl;
+
+		save_lods(mdb, import_info);
 	}
 }
 
@@ -2551,7 +2802,7 @@ void import_scene(FbxScene* scene, const Import_info& import_info)
 {
 	if (import_info.output_type == Output_type::mdb ||
 	    import_info.output_type == Output_type::any)
-		import_models(scene, import_info.output_path.c_str());
+		import_models(scene, import_info);
 
 	if (import_info.output_type == Output_type::mdb)
 		return;
@@ -2619,7 +2870,21 @@ int main(int argc, char* argv[])
 	GR2_file::granny2dll_filename = config.nwn2_home + "\\granny2.dll";
 
 	if(argc < 2) {
-		cout << "Usage: fbx2nw <file>\n";
+		cout << "Usage: fbx2nw [options] <file>\n";
+		cout << "  -o <output>  Output path, without extension\n";
+		cout << "  -no-optimize  Don't reorder the RIGD and SKIN packets\n"
+		        "      for the GPU vertex cache\n";
+		cout << "  -no-merge  Don't merge the RIGD packets with the same\n"
+		        "      material. Merged packets keep the name of the first\n"
+		        "      one\n";
+		cout << "  -tangents  Generate tangents and binormals even if the\n"
+		        "      FBX has them\n";
+		cout << "  -lods <count>  Also save <count> reduced LOD models, each\n"
+		        "      one with half the faces of the previous one\n";
+		cout << "  -col2 <ratio>  If the FBX has no COL2 mesh, derive one\n"
+		        "      from the RIGD and SKIN packets, keeping this fraction\n"
+		        "      of their faces\n";
+		cout << "  -col3 <ratio>  Same as -col2, for the COL3 mesh\n";
 		return 1;
 	}
 
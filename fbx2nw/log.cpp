@@ -10,4 +10,9 @@ namespace Log {
 		++error_count;
 		return std::cout << "ERROR: ";
 	}
+
+	std::ostream& warning()
+	{
+		return std::cout << "WARNING: ";
+	}
 }
\ No newline at end of file
@@ -8,4 +8,6 @@ namespace Log {
 	extern int error_count;
 
 	std::ostream& error();
+	/// Reports a problem that doesn't stop the conversion.
+	std::ostream& warning();
 }
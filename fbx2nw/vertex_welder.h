@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string.h>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "mdb_file.h"
+
+/// Finds duplicated vertices while a mesh is built, so every distinct
+/// vertex is stored once and faces share it.
+///
+/// Vertices are kept in a hash map keyed on their bytes, making each
+/// insertion O(1) on average instead of a linear search over the vertices
+/// added so far. -0 is turned into +0 in the keys, so vertices that compare
+/// equal as floats are welded. With an epsilon, the attributes are also
+/// quantized to a grid of that size before hashing, so vertices that only
+/// differ by rounding noise are welded too. Vertices closer than epsilon
+/// that fall in different grid cells are kept apart.
+template <typename Vertex>
+class Vertex_welder {
+public:
+	static_assert(std::is_trivially_copyable_v<Vertex>);
+
+	/// @param epsilon Size of the quantization grid. If 0, vertices are
+	/// only welded when all their attributes are equal.
+	Vertex_welder(float epsilon = 0)
+	        : epsilon(epsilon)
+	{
+	}
+
+	/// Returns the index of a vertex equal to v in verts, adding v to
+	/// verts if there isn't any. All the vertices of verts must have been
+	/// added through this welder.
+	uint32_t push(std::vector<Vertex>& verts, const Vertex& v)
+	{
+		Vertex key = v;
+		quantize(key);
+
+		auto it = indices.try_emplace(key, uint32_t(verts.size()));
+		if (it.second)
+			verts.push_back(v);
+
+		return it.first->second;
+	}
+
+	/// Reserves space for the expected number of distinct vertices.
+	void reserve(size_t count)
+	{
+		indices.reserve(count);
+	}
+
+private:
+	struct Hash {
+		size_t operator()(const Vertex& v) const
+		{
+			return std::hash<std::string_view>()(
+			    std::string_view((const char*)&v, sizeof(Vertex)));
+		}
+	};
+
+	struct Equal {
+		bool operator()(const Vertex& v1, const Vertex& v2) const
+		{
+			return memcmp(&v1, &v2, sizeof(Vertex)) == 0;
+		}
+	};
+
+	float epsilon;
+	std::unordered_map<Vertex, uint32_t, Hash, Equal> indices;
+
+	float quantize(float x) const
+	{
+		if (epsilon > 0)
+			x = std::round(x / epsilon) * epsilon;
+
+		// Adding 0 turns -0 into +0, so both hash the same.
+		return x + 0.0f;
+	}
+
+	void quantize(Vector3<float>& v) const
+	{
+		v.x = quantize(v.x);
+		v.y = quantize(v.y);
+		v.z = quantize(v.z);
+	}
+
+	void quantize(MDB_file::Collision_mesh_vertex& v) const
+	{
+		quantize(v.position);
+		quantize(v.normal);
+		quantize(v.uvw);
+	}
+
+	void quantize(MDB_file::Rigid_mesh_vertex& v) const
+	{
+		quantize(v.position);
+		quantize(v.normal);
+		quantize(v.tangent);
+		quantize(v.binormal);
+		quantize(v.uvw);
+	}
+
+	void quantize(MDB_file::Skin_vertex& v) const
+	{
+		quantize(v.position);
+		quantize(v.normal);
+		quantize(v.tangent);
+		quantize(v.binormal);
+		quantize(v.uvw);
+
+		for (int i = 0; i < 4; ++i)
+			v.bone_weights[i] = quantize(v.bone_weights[i]);
+	}
+
+	void quantize(MDB_file::Walk_mesh_vertex& v) const
+	{
+		quantize(v.position);
+	}
+};
@@ -0,0 +1,137 @@
+// Copyright 2017 Jose M. Arbos
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "archive_container.h"
+#include "entry_cache.h"
+
+using namespace std;
+
+static uint64_t entry_key(unsigned archive_index, unsigned file_index)
+{
+	return (uint64_t(archive_index) << 32) | file_index;
+}
+
+double Entry_cache::Stats::hit_rate() const
+{
+	auto lookups = hits + misses;
+	return lookups > 0 ? double(hits) / lookups : 0.0;
+}
+
+Entry_cache::Entry_cache(const Archive_container& archives, uint64_t max_size)
+        : archives(archives)
+        , max_size(max_size)
+{
+}
+
+Entry_cache::Buffer Entry_cache::get(unsigned archive_index,
+                                     unsigned file_index)
+{
+	auto key = entry_key(archive_index, file_index);
+
+	unique_lock<mutex> lock(mutex_);
+
+	for (;;) {
+		auto it = index.find(key);
+		if (it != index.end()) {
+			entries.splice(entries.begin(), entries, it->second);
+			++stats_.hits;
+			stats_.bytes_saved += it->second->buffer->size();
+			return it->second->buffer;
+		}
+
+		if (extracting.count(key) == 0)
+			break;
+
+		// Another thread is extracting the file.
+		extracted.wait(lock);
+	}
+
+	++stats_.misses;
+	extracting.insert(key);
+
+	unique_ptr<Archive_container::Extraction_context> context;
+	if (contexts.empty())
+		context = make_unique<Archive_container::Extraction_context>();
+	else {
+		context = move(contexts.back());
+		contexts.pop_back();
+	}
+
+	// The container can be read from several threads, each one with its
+	// own context.
+	lock.unlock();
+
+	auto data = make_shared<vector<unsigned char>>();
+	bool ok = archives.extract_file_to_mem(archive_index, file_index,
+	                                       *data, *context);
+
+	lock.lock();
+
+	contexts.push_back(move(context));
+	extracting.erase(key);
+	extracted.notify_all();
+
+	if (!ok)
+		return nullptr;
+
+	Buffer buffer = move(data);
+
+	if (buffer->size() > max_size)
+		return buffer;
+
+	evict(max_size - buffer->size());
+
+	entries.push_front({key, buffer});
+	index[key] = entries.begin();
+	stats_.size += buffer->size();
+
+	return buffer;
+}
+
+void Entry_cache::set_max_size(uint64_t max_size)
+{
+	lock_guard<mutex> lock(mutex_);
+
+	this->max_size = max_size;
+	evict(max_size);
+}
+
+void Entry_cache::clear()
+{
+	lock_guard<mutex> lock(mutex_);
+
+	entries.clear();
+	index.clear();
+	stats_.size = 0;
+}
+
+Entry_cache::Stats Entry_cache::stats() const
+{
+	lock_guard<mutex> lock(mutex_);
+
+	return stats_;
+}
+
+// Evicts the least recently used files until the cached files take at most
+// max_size bytes.
+void Entry_cache::evict(uint64_t max_size)
+{
+	while (stats_.size > max_size) {
+		auto& e = entries.back();
+		stats_.size -= e.buffer->size();
+		++stats_.evictions;
+		index.erase(e.key);
+		entries.pop_back();
+	}
+}
@@ -0,0 +1,88 @@
+// Copyright 2017 Jose M. Arbos
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "archive_container.h"
+
+/// Least recently used cache of files extracted from an Archive_container.
+///
+/// Files are returned as shared immutable buffers, so a buffer stays
+/// valid while it's used even if the cache evicts it. The total size of
+/// the cached files is kept under a memory budget; files bigger than the
+/// budget are extracted but not cached.
+///
+/// It can be used from several threads. Files are extracted outside the
+/// lock, so threads extract different files concurrently; a thread that
+/// asks for a file being extracted waits for it instead.
+class Entry_cache {
+public:
+	using Buffer = std::shared_ptr<const std::vector<unsigned char>>;
+
+	struct Stats {
+		uint64_t hits;
+		uint64_t misses;
+		/// Bytes that didn't need to be extracted thanks to hits.
+		uint64_t bytes_saved;
+		uint64_t evictions;
+		/// Current size of the cached files.
+		uint64_t size;
+
+		double hit_rate() const;
+	};
+
+	Entry_cache(const Archive_container& archives, uint64_t max_size);
+
+	/// Returns the contents of a file, extracting it if it isn't cached.
+	///
+	/// @return The file contents, or null if it can't be extracted.
+	Buffer get(unsigned archive_index, unsigned file_index);
+
+	/// Changes the memory budget, evicting files if needed.
+	void set_max_size(uint64_t max_size);
+	void clear();
+	Stats stats() const;
+
+private:
+	struct Entry {
+		uint64_t key;
+		Buffer buffer;
+	};
+
+	const Archive_container& archives;
+	uint64_t max_size;
+	mutable std::mutex mutex_;
+	/// Signaled when a file has been extracted.
+	std::condition_variable extracted;
+	/// Files being extracted.
+	std::unordered_set<uint64_t> extracting;
+	/// Contexts not in use by an extraction.
+	std::vector<std::unique_ptr<Archive_container::Extraction_context>>
+	    contexts;
+	/// Most recently used first.
+	std::list<Entry> entries;
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+	Stats stats_ = {};
+
+	void evict(uint64_t max_size);
+};
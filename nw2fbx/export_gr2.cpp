@@ -575,10 +575,10 @@ void export_gr2(Export_info& export_info, const char* filename)
 
 	auto buffer = load_resource(export_info.config, filename);
 
-	if (buffer.empty())
+	if (!buffer || buffer->empty())
 		return;
 
-	Memstream stream(buffer.data(), buffer.size());
+	Memstream stream(buffer->data(), buffer->size());
 	GR2_file gr2(stream);
 
 	if (!gr2)
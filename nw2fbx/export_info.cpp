@@ -1,6 +1,6 @@
-#include <fstream>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 
 #include "config.h"
 #include "export_info.h"
@@ -51,79 +51,129 @@ void process_fbx_bones(Dependency& dep)
 	}
 }
 
-static Archive_container load_model_archives(const Config& config)
+std::string archive_cache_dir()
 {
-	const char* files[] = {
-		"Data/NWN2_Models_X2_v121.zip", "Data/NWN2_Models_X2.zip",
-		"Data/NWN2_Models_X1_v121.zip", "Data/NWN2_Models_X1.zip",
-		"Data/NWN2_Models_v121.zip",    "Data/NWN2_Models_v112.zip",
-		"Data/NWN2_Models_v107.zip",    "Data/NWN2_Models_v106.zip",
-		"Data/NWN2_Models_v105.zip",    "Data/NWN2_Models_v104.zip",
-		"Data/NWN2_Models_v103x1.zip",  "Data/NWN2_Models.zip",
-		"Data/lod-merged_X2_v121.zip", "Data/lod-merged_X2.zip",
-		"Data/lod-merged_X1_v121.zip", "Data/lod-merged_X1.zip",
-		"Data/lod-merged_v121.zip",    "Data/lod-merged_v107.zip",
-		"Data/lod-merged_v101.zip",    "Data/lod-merged.zip" };
-
-	Archive_container archives;
-	for (unsigned i = 0; i < sizeof(files) / sizeof(char*); ++i) {
-		cout << "Indexing: " << files[i];
-		fs::path p = fs::path(config.nwn2_home) / fs::path(files[i]);
-		if (!archives.add_archive(p.string().c_str())) {
+	std::error_code ec;
+	auto dir = fs::temp_directory_path(ec);
+	if (ec)
+		return "";
+
+	return (dir / "nwn2mdk" / "archive_cache").string();
+}
+
+// Model archives, relative to the NWN2 directory, from highest to lowest
+// priority.
+static const char* model_archive_files[] = {
+	"Data/NWN2_Models_X2_v121.zip", "Data/NWN2_Models_X2.zip",
+	"Data/NWN2_Models_X1_v121.zip", "Data/NWN2_Models_X1.zip",
+	"Data/NWN2_Models_v121.zip",    "Data/NWN2_Models_v112.zip",
+	"Data/NWN2_Models_v107.zip",    "Data/NWN2_Models_v106.zip",
+	"Data/NWN2_Models_v105.zip",    "Data/NWN2_Models_v104.zip",
+	"Data/NWN2_Models_v103x1.zip",  "Data/NWN2_Models.zip",
+	"Data/lod-merged_X2_v121.zip", "Data/lod-merged_X2.zip",
+	"Data/lod-merged_X1_v121.zip", "Data/lod-merged_X1.zip",
+	"Data/lod-merged_v121.zip",    "Data/lod-merged_v107.zip",
+	"Data/lod-merged_v101.zip",    "Data/lod-merged.zip" };
+
+std::vector<std::string> model_archive_paths(const Config& config)
+{
+	std::vector<std::string> paths;
+	for (auto file : model_archive_files)
+		paths.push_back(
+		    (fs::path(config.nwn2_home) / fs::path(file)).string());
+
+	return paths;
+}
+
+static Resource_fs load_model_resources(const Config& config)
+{
+	Resource_fs resources;
+	resources.set_cache_dir(archive_cache_dir().c_str());
+
+	// Files in the working directory override the ones in the archives.
+	// The directory is indexed once, so inputs written later with -x
+	// aren't seen, and are read again from the archives they came from.
+	resources.mount_dir(".");
+
+	auto paths = model_archive_paths(config);
+	auto opened = resources.mount_archives(paths);
+
+	for (size_t i = 0; i < paths.size(); ++i) {
+		cout << "Indexing: " << model_archive_files[i];
+		if (!opened[i])
 			cout << " : Cannot open zip";
-		}
 		cout << endl;
 	}
 
-	return archives;
+	return resources;
 }
 
-Archive_container& model_archives(const Config& config)
+const Resource_fs& model_resources(const Config& config)
 {
-	static auto a = load_model_archives(config);
-	return a;
+	static auto r = load_model_resources(config);
+	return r;
 }
 
-static std::vector<unsigned char> read_file(const char* filename)
+const Archive_container& model_archives(const Config& config)
 {
-	vector<unsigned char> buffer;
-
-	ifstream in(filename, ios::in | ios::binary);
+	return model_resources(config).archives();
+}
 
-	if (!in)
-		return buffer;
+// Created on the first load_resource() call from the archives.
+static std::unique_ptr<Entry_cache> resource_cache;
 
-	// Get file size
-	in.seekg(0, ios::end);
-	auto size = in.tellg();
-	in.seekg(0, ios::beg);
+void print_resource_cache_stats()
+{
+	if (!resource_cache)
+		return;
 
-	buffer.resize(size);
-	in.read((char *)buffer.data(), size);
+	auto stats = resource_cache->stats();
+	if (stats.hits + stats.misses == 0)
+		return;
 
-	return buffer;
+	cout << "Resource cache: " << stats.hits << " hits, " << stats.misses
+	     << " misses (" << int(stats.hit_rate() * 100 + 0.5)
+	     << "% hit rate), " << (stats.bytes_saved + 1023) / 1024
+	     << " KB not extracted again\n";
 }
 
-std::vector<unsigned char> load_resource(const Config& config,
-                                         const char* filename)
+Entry_cache::Buffer load_resource(const Config& config, const char* filename)
 {
-	if (fs::exists(filename))
-		return read_file(filename);
+	static auto& resources = model_resources(config);
+
+	auto location = resources.find(filename);
+	if (location && location->source == Resource_fs::LOOSE) {
+		auto buffer = make_shared<vector<unsigned char>>();
+		if (!resources.read(*location, *buffer)) {
+			cout << "Cannot read " << filename << endl;
+			return nullptr;
+		}
+		return buffer;
+	}
 
-	static auto& archives = model_archives(config);
-	auto r = archives.find_file(filename);
-	if (r.matches == 0)
-		return {};
+	auto& archives = resources.archives();
+	if (!location) {
+		// Not a file name, try a substring of the archive paths.
+		auto r = archives.find_file(filename);
+		if (r.matches == 0) {
+			cout << filename << " not found\n";
+			return nullptr;
+		}
+		location = Resource_fs::Location{Resource_fs::ARCHIVE,
+		                                 r.archive_index, r.file_index};
+	}
 
 	cout << "Extracting: " << filename << endl;
 
-	vector<unsigned char> buffer;
+	// Skeletons and textures shared by several inputs are extracted
+	// only once.
+	if (!resource_cache)
+		resource_cache.reset(new Entry_cache(archives, 256 << 20));
 
-	if (!archives.extract_file_to_mem(r.archive_index, r.file_index,
-	                                  buffer)) {
+	auto buffer = resource_cache->get(location->archive_index,
+	                                  location->file_index);
+	if (!buffer)
 		cout << "  Cannot extract\n";
-		return {};
-	}
 
 	return buffer;
 }
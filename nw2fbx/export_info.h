@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "archive_container.h"
+#include "entry_cache.h"
+#include "resource_fs.h"
 #include "fbxsdk.h"
 
 class Config;
@@ -25,16 +27,31 @@ struct Export_info {
 	/// Command line arguments that are not options.
 	std::vector<std::string> input_strings;
 	std::string output_path;
-	Archive_container materials;
+	/// Working directory and material archives.
+	Resource_fs materials;
 	const MDB_file *mdb;
 	std::string mdb_skeleton_name;
 	FbxScene *scene;
 	std::map<std::string, Dependency> dependencies;
+	/// Write the inputs found in the archives to the working directory.
+	/// Otherwise they are only kept in memory.
+	bool write_extracted = false;
 
 	Dependency* find_skeleton_dependency(const char* skeleton_name);
 };
 
 void process_fbx_bones(Dependency& dep);
-Archive_container& model_archives(const Config& config);
-std::vector<unsigned char> load_resource(const Config& config,
-                                         const char* filename);
+/// Returns the directory where the indices of the NWN2 archives are
+/// cached, or an empty string if there's no temporary directory.
+std::string archive_cache_dir();
+/// Returns the paths of the model archives, from highest to lowest
+/// priority.
+std::vector<std::string> model_archive_paths(const Config& config);
+/// Working directory and model archives.
+const Resource_fs& model_resources(const Config& config);
+const Archive_container& model_archives(const Config& config);
+/// Returns the contents of a file of the working directory or the model
+/// archives, or null if it can't be found or extracted.
+Entry_cache::Buffer load_resource(const Config& config, const char* filename);
+/// Prints the hits and misses of the cache of load_resource().
+void print_resource_cache_stats();
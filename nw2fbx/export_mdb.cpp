@@ -939,12 +939,15 @@ static void export_packet(Export_info& export_info,
 	}
 }
 
-static bool exists_texture(const char* name)
+// Checks if a texture is in the working directory. The index of the
+// resources is used, so the file system isn't queried.
+static bool exists_texture(const Resource_fs& resources, const char* name)
 {
-	if (exists(path(name).concat(".dds")))
-		return true;
-	else if (exists(path(name).concat(".tga")))
-		return true;
+	for (auto ext : {".dds", ".tga"}) {
+		auto location = resources.find((string(name) + ext).c_str());
+		if (location && location->source == Resource_fs::LOOSE)
+			return true;
+	}
 
 	return false;
 }
@@ -967,7 +970,8 @@ static void extract_dependency(Export_info& export_info, const char* str,
 
 		cout << "Extracting: " << p.string() << endl;
 
-		if (exists(p)) {
+		auto location = export_info.materials.find(p.string().c_str());
+		if (location && location->source == Resource_fs::LOOSE) {
 			dep.extracted = true;
 			cout << "  Already exists in destination. Don't overwrite.\n";
 			return;
@@ -977,6 +981,10 @@ static void extract_dependency(Export_info& export_info, const char* str,
 			p.string().c_str())) {
 			cout << "Cannot extract " << str << endl;
 		}
+		else {
+			// The working directory was indexed at startup.
+			export_info.materials.add_file(p.string().c_str());
+		}
 
 		dep.extracted = true;
 	}
@@ -987,21 +995,23 @@ static void extract_dependency(Export_info& export_info, const char* str,
 static void extract_textures(Export_info& export_info,
 	const MDB_file::Material& material)
 {
+	auto& resources = export_info.materials;
+
 	string diffuse_map = string(material.diffuse_map_name, 32).c_str();
-	if (!diffuse_map.empty() && !exists_texture(diffuse_map.c_str()))
-		extract_dependency(export_info, diffuse_map.c_str(), export_info.materials);
+	if (!diffuse_map.empty() && !exists_texture(resources, diffuse_map.c_str()))
+		extract_dependency(export_info, diffuse_map.c_str(), resources.archives());
 
 	string normal_map = string(material.normal_map_name, 32).c_str();
-	if (!normal_map.empty() && !exists_texture(normal_map.c_str()))
-		extract_dependency(export_info, normal_map.c_str(), export_info.materials);
+	if (!normal_map.empty() && !exists_texture(resources, normal_map.c_str()))
+		extract_dependency(export_info, normal_map.c_str(), resources.archives());
 
 	string tint_map = string(material.tint_map_name, 32).c_str();
-	if (!tint_map.empty() && !exists_texture(tint_map.c_str()))
-		extract_dependency(export_info, tint_map.c_str(), export_info.materials);
+	if (!tint_map.empty() && !exists_texture(resources, tint_map.c_str()))
+		extract_dependency(export_info, tint_map.c_str(), resources.archives());
 
 	string glow_map = string(material.glow_map_name, 32).c_str();
-	if (!glow_map.empty() && !exists_texture(glow_map.c_str()))
-		extract_dependency(export_info, glow_map.c_str(), export_info.materials);
+	if (!glow_map.empty() && !exists_texture(resources, glow_map.c_str()))
+		extract_dependency(export_info, glow_map.c_str(), resources.archives());
 }
 
 static void extract_textures(Export_info& export_info,
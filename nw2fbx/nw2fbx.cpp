@@ -13,7 +13,9 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 
 #include "app_info.h"
@@ -25,6 +27,7 @@
 #include "fbxsdk.h"
 #include "gr2_file.h"
 #include "mdb_file.h"
+#include "memstream.h"
 #include "redirect_output_handle.h"
 
 // Uncomment for print extra info
@@ -329,7 +332,7 @@ static void print_mdb(const MDB_file& mdb)
 		print_packet(mdb.packet(i));
 }
 
-static Archive_container get_material_archives(const Config& config)
+static Resource_fs get_material_resources(const Config& config)
 {
 	const char* files[] = { "Data/NWN2_Materials_X2.zip",
 		"Data/NWN2_Materials_X1_v121.zip",
@@ -344,17 +347,27 @@ static Archive_container get_material_archives(const Config& config)
 		"Data/NWN2_Materials_v103x1.zip",
 		"Data/NWN2_Materials.zip" };
 
-	Archive_container archives;
+	Resource_fs resources;
+	resources.set_cache_dir(archive_cache_dir().c_str());
+
+	// Textures in the working directory aren't extracted again.
+	resources.mount_dir(".");
+
+	std::vector<std::string> paths;
+	for (auto file : files)
+		paths.push_back(
+		    (path(config.nwn2_home) / path(file)).string());
+
+	auto opened = resources.mount_archives(paths);
+
 	for (unsigned i = 0; i < sizeof(files) / sizeof(char*); ++i) {
 		cout << "Indexing: " << files[i];
-		path p = path(config.nwn2_home) / path(files[i]);
-		if (!archives.add_archive(p.string().c_str())) {
+		if (!opened[i])
 			cout << " : Cannot open zip";
-		}
 		cout << endl;
 	}
 
-	return archives;
+	return resources;
 }
 
 static void parse_args(Export_info& export_info, int argc, char* argv[])
@@ -363,6 +376,8 @@ static void parse_args(Export_info& export_info, int argc, char* argv[])
 		if (argv[i][0] == '-') {
 			if (strcmp(argv[i], "-o") == 0 && i < argc - 1)
 				export_info.output_path = argv[++i];
+			else if (strcmp(argv[i], "-x") == 0)
+				export_info.write_extracted = true;
 		}
 		else {
 			export_info.input_strings.push_back(argv[i]);
@@ -370,45 +385,141 @@ static void parse_args(Export_info& export_info, int argc, char* argv[])
 	}
 }
 
-static bool extract_arg(const Config& config, const char* arg,
-	std::vector<std::string> &filenames)
+// Finds the file of the archives that matches an argument.
+static bool find_arg(const Archive_container& archives, const char* arg,
+	Archive_container::File_ref& file)
 {
-	if (exists(arg)) { // File is already extracted
-		filenames.push_back(arg);
-		return true;
+	auto r = archives.find_file(arg);
+	if (r.matches == 0) {
+		cout << arg << " not found\n";
+		return false;
+	}
+	else if (r.matches > 1) {
+		cout << '"' << arg << "\" matches " << r.matches << " files:\n";
+		for (auto& f : archives.find_files(arg, 20))
+			cout << "  " << f << endl;
+		return false;
 	}
 
-	static auto& archives = model_archives(config);
+	file = {r.archive_index, r.file_index};
 
-	cout << '\n';
+	return true;
+}
 
-	auto r = archives.find_file(arg);
-	if (r.matches != 1)
-		return false;
+// An input file, either on disk or extracted from the archives to memory.
+struct Input_file {
+	std::string filename;
+	bool in_memory;
+	std::vector<unsigned char> data;
+};
 
-	path p(archives.filename(r.archive_index, r.file_index));
-	p = p.filename();
-	string filename = p.string();
+static bool extract_args(Export_info& export_info,
+	std::vector<Input_file> &input_files)
+{
+	const Archive_container* archives = nullptr;
+	std::vector<Archive_container::File_ref> files;
+	std::vector<Archive_container::File_stat> stats;
+	std::vector<size_t> file_inputs;
+	// Inputs identical to an extracted input, and the input they copy.
+	std::vector<std::pair<size_t, size_t>> copies;
 
-	cout << "Extracting: " << filename << endl;
+	for (auto &s : export_info.input_strings) {
+		if (exists(s)) { // File is already extracted
+			input_files.push_back({s, false, {}});
+			continue;
+		}
 
-	if (!archives.extract_file(r.archive_index, r.file_index,
-		filename.c_str())) {
-		cout << "  Cannot extract\n";
-		return false;
+		if (!archives) {
+			archives = &model_archives(export_info.config);
+			cout << '\n';
+		}
+
+		Archive_container::File_ref file;
+		if (!find_arg(*archives, s.c_str(), file))
+			return false;
+
+		path p(archives->filename(file.archive_index, file.file_index));
+		string filename = p.filename().string();
+
+		auto it = find_if(input_files.begin(), input_files.end(),
+			[&](auto& f) { return f.filename == filename; });
+		if (it != input_files.end())
+			continue;
+
+		Archive_container::File_stat stat;
+		if (!archives->file_stat(file.archive_index, file.file_index,
+			stat)) {
+			cout << "Cannot extract " << filename << endl;
+			return false;
+		}
+
+		// Identical copies with another name are extracted once, and
+		// still converted under their own name.
+		auto dup = find_if(stats.begin(), stats.end(), [&](auto& s) {
+			return s.uncomp_size == stat.uncomp_size &&
+			       s.crc32 == stat.crc32;
+		});
+		if (dup != stats.end()) {
+			auto original = file_inputs[dup - stats.begin()];
+			cout << filename << " is identical to "
+			     << input_files[original].filename
+			     << ". Extracted once.\n";
+			copies.push_back({input_files.size(), original});
+			input_files.push_back({filename, true, {}});
+			continue;
+		}
+
+		cout << "Extracting: " << filename << endl;
+
+		files.push_back(file);
+		stats.push_back(stat);
+		file_inputs.push_back(input_files.size());
+		input_files.push_back({filename, true, {}});
+	}
+
+	if (files.empty())
+		return true;
+
+	// All the inputs are extracted at once, in parallel, and kept in
+	// memory. Each thread writes a different input.
+	auto extracted = archives->extract_files_to_mem(files,
+		[&](size_t i, std::vector<unsigned char>& data) {
+			input_files[file_inputs[i]].data = move(data);
+		});
+
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (!extracted[i]) {
+			cout << "Cannot extract "
+			     << input_files[file_inputs[i]].filename << endl;
+			return false;
+		}
 	}
 
-	filenames.push_back(filename);
-	
+	for (auto [input, original] : copies)
+		input_files[input].data = input_files[original].data;
+
 	return true;
 }
 
-static bool extract_args(Export_info& export_info,
-	std::vector<std::string> &filenames)
+// Writes the inputs extracted to memory to the working directory.
+static bool write_extracted_args(const std::vector<Input_file>& input_files)
 {
-	for (auto &s : export_info.input_strings) {
-		if (!extract_arg(export_info.config, s.c_str(), filenames))
+	for (auto& f : input_files) {
+		if (!f.in_memory)
+			continue;
+
+		if (exists(f.filename)) {
+			cout << f.filename
+			     << " already exists in destination. Don't overwrite.\n";
+			continue;
+		}
+
+		ofstream out(f.filename, ios::binary);
+		out.write((const char*)f.data.data(), f.data.size());
+		if (!out) {
+			cout << "Cannot write " << f.filename << endl;
 			return false;
+		}
 	}
 
 	return true;
@@ -420,11 +531,15 @@ struct Input {
 	std::unique_ptr<GR2_file> gr2;
 };
 
-static bool open_mdb(vector<Input>& inputs, const char* filename)
+static bool open_mdb(vector<Input>& inputs, const Input_file& file)
 {
 	Input input;
-	input.filename = filename;
-	input.mdb.reset(new MDB_file(filename));
+	input.filename = file.filename;
+	if (file.in_memory)
+		input.mdb.reset(
+			new MDB_file(file.data.data(), file.data.size()));
+	else
+		input.mdb.reset(new MDB_file(file.filename.c_str()));
 	if (!(*input.mdb)) {
 		cout << input.mdb->error_str() << endl;
 		return false;
@@ -434,11 +549,16 @@ static bool open_mdb(vector<Input>& inputs, const char* filename)
 	return true;
 }
 
-static bool open_gr2(vector<Input>& inputs, const char* filename)
+static bool open_gr2(vector<Input>& inputs, const Input_file& file)
 {
 	Input input;
-	input.filename = filename;
-	input.gr2.reset(new GR2_file(filename));
+	input.filename = file.filename;
+	if (file.in_memory) {
+		Memstream stream(file.data.data(), file.data.size());
+		input.gr2.reset(new GR2_file(stream));
+	}
+	else
+		input.gr2.reset(new GR2_file(file.filename.c_str()));
 	if (!(*input.gr2)) {
 		cout << input.gr2->error_string() << endl;
 		return false;
@@ -448,26 +568,27 @@ static bool open_gr2(vector<Input>& inputs, const char* filename)
 	return true;
 }
 
-static bool open_file(vector<Input>& inputs, const char* filename)
+static bool open_file(vector<Input>& inputs, const Input_file& file)
 {
-	auto ext = path(filename).extension().string();
+	auto ext = path(file.filename).extension().string();
 	transform(ext.begin(), ext.end(), ext.begin(), ::toupper);
 	if (ext == ".MDB") {
-		if (!open_mdb(inputs, filename))
+		if (!open_mdb(inputs, file))
 			return false;
 	}
 	else if (ext == ".GR2") {
-		if (!open_gr2(inputs, filename))
+		if (!open_gr2(inputs, file))
 			return false;
 	}
 
 	return true;
 }
 
-static bool open_files(vector<Input>& inputs, const std::vector<std::string>& filenames)
+static bool open_files(vector<Input>& inputs,
+	const std::vector<Input_file>& input_files)
 {
-	for (auto &filename : filenames) {
-		if (!open_file(inputs, filename.c_str()))
+	for (auto &file : input_files) {
+		if (!open_file(inputs, file))
 			return false;
 	}
 
@@ -536,20 +657,27 @@ static bool process_args(Export_info& export_info, int argc, char* argv[])
 	if (export_info.input_strings.empty())
 		return false;
 
-	// Extracted filenames without including the path.
-	vector<std::string> filenames;
+	// Filenames of the extracted inputs don't include the path.
+	vector<Input_file> input_files;
+
+	if (!extract_args(export_info, input_files))
+		return false;
 
-	if (!extract_args(export_info, filenames))
+	if (export_info.write_extracted &&
+	    !write_extracted_args(input_files))
 		return false;
 
 	if (export_info.output_path.empty())
-		export_info.output_path = path(filenames[0]).stem().concat(".fbx").string();
+		export_info.output_path = path(input_files[0].filename).stem().concat(".fbx").string();
 
 	vector<Input> inputs;
 
-	if (!open_files(inputs, filenames))
+	if (!open_files(inputs, input_files))
 		return false;
 
+	// The parsed files don't reference the extracted data.
+	input_files.clear();
+
 	if (!export_skeletons(export_info, inputs))
 		return false;
 
@@ -562,6 +690,126 @@ static bool process_args(Export_info& export_info, int argc, char* argv[])
 	return true;
 }
 
+// Measures the throughput of each inflate backend over the deflated files
+// of the model archives, in a single thread.
+static void benchmark_inflate(const Config& config)
+{
+	Archive_container archives;
+	archives.set_cache_dir(archive_cache_dir().c_str());
+	archives.add_archives(model_archive_paths(config));
+
+	std::vector<Archive_container::File_ref> files;
+	uint64_t comp_size = 0;
+	uint64_t uncomp_size = 0;
+
+	for (unsigned i = 0; i < archives.archive_count(); ++i) {
+		for (unsigned j = 0; j < archives.file_count(i); ++j) {
+			Archive_container::File_stat stat;
+			if (archives.file_stat(i, j, stat) && stat.compressed) {
+				files.push_back({i, j});
+				comp_size += stat.comp_size;
+				uncomp_size += stat.uncomp_size;
+			}
+		}
+	}
+
+	cout << files.size() << " deflated files, " << (comp_size >> 20)
+	     << " MB compressed, " << (uncomp_size >> 20) << " MB uncompressed\n";
+
+	std::span<const unsigned char> data;
+	Archive_container::Extraction_context context;
+
+	// The first pass loads the archives in the file cache, so all the
+	// backends are measured without I/O.
+	cout << "Warming up\n";
+	for (auto& f : files)
+		archives.file_view(f.archive_index, f.file_index, data, context);
+
+	for (auto backend : Inflater::available_backends()) {
+		archives.set_inflate_backend(backend);
+
+		size_t failed = 0;
+		auto start = chrono::steady_clock::now();
+		for (auto& f : files) {
+			if (!archives.file_view(f.archive_index, f.file_index,
+			                        data, context))
+				++failed;
+		}
+		chrono::duration<double> time =
+		    chrono::steady_clock::now() - start;
+
+		cout << Inflater::backend_name(backend) << ": "
+		     << time.count() << " s, "
+		     << uncomp_size / 1048576.0 / time.count() << " MB/s";
+		if (failed > 0)
+			cout << " (" << failed << " files failed)";
+		cout << endl;
+	}
+}
+
+// Reports the files of the model archives that are stored more than once,
+// and the size of the corpus without them.
+static void print_duplicates(const Config& config)
+{
+	auto& archives = model_archives(config);
+
+	uint64_t file_count = 0;
+	uint64_t total_size = 0;
+	for (unsigned i = 0; i < archives.archive_count(); ++i) {
+		for (unsigned j = 0; j < archives.file_count(i); ++j) {
+			Archive_container::File_stat stat;
+			if (archives.file_stat(i, j, stat)) {
+				++file_count;
+				total_size += stat.uncomp_size;
+			}
+		}
+	}
+
+	auto groups = archives.find_duplicates();
+
+	// Size of the redundant copies of each group.
+	auto redundant_size = [&](const auto& group) -> uint64_t {
+		Archive_container::File_stat stat;
+		if (!archives.file_stat(group[0].archive_index,
+		                        group[0].file_index, stat))
+			return 0;
+		return stat.uncomp_size * (group.size() - 1);
+	};
+
+	uint64_t redundant_count = 0;
+	uint64_t redundant_total = 0;
+	for (auto& group : groups) {
+		redundant_count += group.size() - 1;
+		redundant_total += redundant_size(group);
+	}
+
+	std::sort(groups.begin(), groups.end(), [&](auto& a, auto& b) {
+		return redundant_size(a) > redundant_size(b);
+	});
+
+	cout << "\nLargest duplicates:\n";
+	for (size_t i = 0; i < groups.size() && i < 20; ++i) {
+		cout << "  " << (redundant_size(groups[i]) >> 10) << " KB in "
+		     << groups[i].size() << " copies:\n";
+		for (auto& f : groups[i])
+			cout << "    "
+			     << path(archives.archive_filename(f.archive_index))
+			            .filename()
+			            .string()
+			     << ": "
+			     << archives.filename(f.archive_index, f.file_index)
+			     << endl;
+	}
+
+	cout << "\nFiles: " << file_count << ", " << (total_size >> 20)
+	     << " MB\n";
+	cout << "Duplicates: " << redundant_count << " redundant copies of "
+	     << groups.size() << " files, " << (redundant_total >> 20)
+	     << " MB\n";
+	cout << "Unique: " << file_count - redundant_count << " files, "
+	     << ((total_size - redundant_total) >> 20) << " MB\n";
+}
+
 int main(int argc, char* argv[])
 {
 	Redirect_output_handle redirect_output_handle;
@@ -576,10 +824,28 @@ int main(int argc, char* argv[])
 	GR2_file::granny2dll_filename = config.nwn2_home + "\\granny2.dll";
 
 	if (argc < 2) {
-		cout << "Usage: nw2fbx <file|substring ...>\n";
+		cout << "Usage: nw2fbx [-o output] [-x] <file|substring ...>\n";
+		cout << "       nw2fbx -bench-inflate\n";
+		cout << "       nw2fbx -duplicates\n";
+		cout << "  -x  Also write the inputs found in the archives to the\n"
+		        "      working directory\n";
+		cout << "  -bench-inflate  Measure the decompression speed of each\n"
+		        "      inflate backend over the model archives\n";
+		cout << "  -duplicates  Report the files stored more than once in\n"
+		        "      the model archives\n";
 		return 1;
 	}	
 
+	if (strcmp(argv[1], "-bench-inflate") == 0) {
+		benchmark_inflate(config);
+		return 0;
+	}
+
+	if (strcmp(argv[1], "-duplicates") == 0) {
+		print_duplicates(config);
+		return 0;
+	}
+
 	auto manager = FbxManager::Create();
 	if (!manager) {
 		cout << "ERROR: Unable to create FBX manager\n";
@@ -602,7 +868,7 @@ int main(int argc, char* argv[])
 	scene->GetGlobalSettings().SetTimeMode(FbxTime::eFrames30);
 
 	Export_info export_info = { config, {}, "",
-		get_material_archives(config), nullptr, "", scene };
+		get_material_resources(config), nullptr, "", scene };
 
 	if (!process_args(export_info, argc, argv))
 		return 1;
@@ -620,5 +886,7 @@ int main(int argc, char* argv[])
 
 	manager->Destroy();
 
+	print_resource_cache_stats();
+
 	cout << "\nOutput is " << export_info.output_path.c_str() << endl;
 }
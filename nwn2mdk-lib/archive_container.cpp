@@ -0,0 +1,999 @@
+// Copyright 2017 Jose M. Arbos
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string.h>
+
+#include "archive_container.h"
+#include "parallel_for.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Header of an archive index cache file. It's followed by:
+///
+/// - File_info files[file_count]
+/// - uint32_t name_offsets[file_count]
+/// - uint32_t trigrams[trigram_count]
+/// - uint32_t trigram_offsets[trigram_count + 1]
+/// - uint32_t trigram_files[trigram_file_count]
+/// - char path[path_size] (archive path, to detect hash collisions)
+/// - char names[names_size]
+///
+/// The file is read at once and each array is copied out of it, so the
+/// arrays don't need to be aligned.
+struct Cache_header {
+	char signature[4]; // Should be "NWZI"
+	uint32_t version;
+	uint64_t archive_size;
+	int64_t archive_time;
+	uint32_t path_size;
+	uint32_t file_count;
+	uint32_t names_size;
+	uint32_t trigram_count;
+	uint32_t trigram_file_count;
+	uint32_t padding;
+};
+
+static_assert(sizeof(Cache_header) == 48);
+
+} // namespace
+
+const uint32_t cache_version = 1;
+
+// Size and signature of the header that precedes each file in a zip.
+const size_t local_header_size = 30;
+const uint32_t local_header_signature = 0x04034b50;
+
+static char to_upper(char c)
+{
+	return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+// Copies an uppercase version of str to a buffer of
+// MZ_ZIP_MAX_ARCHIVE_FILENAME_SIZE characters. Longer strings can't match
+// any file name.
+//
+// @return False if the string is too long.
+static bool to_upper(const char* str, char* buffer, std::string_view& upper)
+{
+	size_t len = strlen(str);
+	if (len >= MZ_ZIP_MAX_ARCHIVE_FILENAME_SIZE)
+		return false;
+
+	for (size_t i = 0; i < len; ++i)
+		buffer[i] = to_upper(str[i]);
+
+	upper = std::string_view(buffer, len);
+
+	return true;
+}
+
+static std::string_view basename(std::string_view path)
+{
+	auto pos = path.find_last_of("/\\");
+	return pos == std::string_view::npos ? path : path.substr(pos + 1);
+}
+
+static uint32_t trigram(const char* s)
+{
+	return (uint32_t((unsigned char)s[0]) << 16) |
+	       (uint32_t((unsigned char)s[1]) << 8) | (unsigned char)s[2];
+}
+
+// 64-bit FNV-1a. Unlike std::hash, it's the same in every build, so cache
+// file names stay valid.
+static uint64_t fnv1a(std::string_view s)
+{
+	uint64_t h = 0xcbf29ce484222325;
+	for (unsigned char c : s) {
+		h ^= c;
+		h *= 0x100000001b3;
+	}
+
+	return h;
+}
+
+// Gets the size and modification time that identify a version of the
+// archive.
+static bool archive_stamp(const std::string& filename, uint64_t& size,
+                          int64_t& time)
+{
+	std::error_code ec;
+	size = fs::file_size(filename, ec);
+	if (ec)
+		return false;
+
+	time = fs::last_write_time(filename, ec).time_since_epoch().count();
+
+	return !ec;
+}
+
+static uint32_t read_le(const unsigned char* p, int bytes)
+{
+	uint32_t v = 0;
+	for (int i = bytes - 1; i >= 0; --i)
+		v = (v << 8) | p[i];
+
+	return v;
+}
+
+// Returns the offset of the data of a file, given its local header.
+static uint64_t data_offset(const unsigned char* local_header,
+                            uint64_t local_header_offset)
+{
+	// The name and extra field lengths can differ from the central
+	// directory, so they are taken from the local header.
+	return local_header_offset + local_header_size +
+	       read_le(local_header + 26, 2) + read_le(local_header + 28, 2);
+}
+
+template <typename T>
+static void write_array(std::ostream& out, const std::vector<T>& v)
+{
+	out.write((const char*)v.data(), v.size() * sizeof(T));
+}
+
+template <typename T>
+static bool read_array(const std::vector<char>& data, size_t& offset,
+                       size_t count, std::vector<T>& v)
+{
+	if (count > (data.size() - offset) / sizeof(T))
+		return false;
+
+	v.resize(count);
+	if (count > 0)
+		memcpy(v.data(), data.data() + offset, count * sizeof(T));
+	offset += count * sizeof(T);
+
+	return true;
+}
+
+static std::string_view entry_name(const std::vector<char>& names,
+                                   const std::vector<uint32_t>& offsets,
+                                   unsigned file_index)
+{
+	auto begin = offsets[file_index];
+	auto end = file_index + 1 < offsets.size()
+	               ? offsets[file_index + 1] - 1
+	               : uint32_t(names.size() - 1);
+
+	return {names.data() + begin, end - begin};
+}
+
+Archive_container::Extraction_context::Extraction_context() = default;
+
+Archive_container::Extraction_context::~Extraction_context() = default;
+
+unsigned char*
+Archive_container::Extraction_context::Buffer::reserve(size_t size)
+{
+	if (capacity < size) {
+		data.reset(new unsigned char[size]);
+		capacity = size;
+	}
+
+	return data.get();
+}
+
+void Archive_container::Zip_deleter::operator()(mz_zip_archive* zip) const
+{
+	mz_zip_reader_end(zip);
+	delete zip;
+}
+
+std::string_view Archive_container::Archive_entry::name(unsigned file_index) const
+{
+	return entry_name(names, name_offsets, file_index);
+}
+
+std::string_view
+Archive_container::Archive_entry::upper_name(unsigned file_index) const
+{
+	return entry_name(upper_names, name_offsets, file_index);
+}
+
+void Archive_container::set_cache_dir(const char* dir)
+{
+	cache_dir = dir;
+}
+
+void Archive_container::set_inflate_backend(Inflater::Backend backend)
+{
+	auto backends = Inflater::available_backends();
+	if (std::find(backends.begin(), backends.end(), backend) !=
+	    backends.end())
+		inflate_backend = backend;
+}
+
+bool Archive_container::add_archive(const char* filename)
+{
+	Archive_entry e;
+	e.filename = filename;
+
+	if (!load_archive(e))
+		return false;
+
+	index_basenames(e, unsigned(archives.size()));
+	archives.push_back(std::move(e));
+
+	return true;
+}
+
+std::vector<bool>
+Archive_container::add_archives(std::span<const std::string> filenames,
+                                unsigned thread_count)
+{
+	std::vector<Archive_entry> entries(filenames.size());
+	// Not std::vector<bool>, as threads write to adjacent elements.
+	std::vector<char> loaded(filenames.size());
+
+	parallel_for(
+	    0, filenames.size(),
+	    [&](size_t i) {
+		    entries[i].filename = filenames[i];
+		    loaded[i] = load_archive(entries[i]);
+	    },
+	    thread_count);
+
+	// The base names are indexed in order, so the first archive in the
+	// list wins as with add_archive().
+	std::vector<bool> result(filenames.size());
+
+	for (size_t i = 0; i < entries.size(); ++i) {
+		result[i] = loaded[i];
+		if (!loaded[i])
+			continue;
+
+		index_basenames(entries[i], unsigned(archives.size()));
+		archives.push_back(std::move(entries[i]));
+	}
+
+	return result;
+}
+
+// Reads the index of an archive from the cache, or from the zip if it
+// isn't cached.
+bool Archive_container::load_archive(Archive_entry& entry) const
+{
+	if (load_cache(entry))
+		return true;
+
+	if (!read_central_directory(entry))
+		return false;
+
+	build_trigrams(entry);
+	save_cache(entry);
+
+	return true;
+}
+
+const Mapped_file* Archive_container::mapped_file(unsigned archive_index) const
+{
+	auto& entry = archives[archive_index];
+
+	// If the archive can't be mapped, it isn't tried again.
+	std::call_once(*entry.mapping_once, [&] {
+		auto mapping =
+		    std::make_unique<Mapped_file>(entry.filename.c_str());
+		if (*mapping)
+			entry.mapping = std::move(mapping);
+	});
+
+	return entry.mapping.get();
+}
+
+bool Archive_container::read_central_directory(Archive_entry& entry) const
+{
+	// Files are read with the entries of the index, so the reader is only
+	// needed here.
+	std::unique_ptr<mz_zip_archive, Zip_deleter> zip(new mz_zip_archive);
+	mz_zip_zero_struct(zip.get());
+
+	if (!mz_zip_reader_init_file(zip.get(), entry.filename.c_str(), 0)) {
+		// Not initialized, so it mustn't be ended.
+		delete zip.release();
+		return false;
+	}
+
+	unsigned file_count = mz_zip_reader_get_num_files(zip.get());
+
+	entry.files.reserve(file_count);
+	entry.name_offsets.reserve(file_count);
+
+	for (unsigned i = 0; i < file_count; ++i) {
+		mz_zip_archive_file_stat stat;
+		if (!mz_zip_reader_file_stat(zip.get(), i, &stat))
+			memset(&stat, 0, sizeof(stat));
+
+		entry.files.push_back({stat.m_local_header_ofs, stat.m_comp_size,
+		                       stat.m_uncomp_size, stat.m_crc32,
+		                       stat.m_method, stat.m_bit_flag});
+
+		entry.name_offsets.push_back(uint32_t(entry.names.size()));
+
+		for (const char* c = stat.m_filename; *c; ++c)
+			entry.names.push_back(*c);
+		entry.names.push_back('\0');
+	}
+
+	entry.upper_names.resize(entry.names.size());
+	std::transform(entry.names.begin(), entry.names.end(),
+	               entry.upper_names.begin(),
+	               [](char c) { return to_upper(c); });
+
+	return true;
+}
+
+void Archive_container::build_trigrams(Archive_entry& entry) const
+{
+	// Pairs of trigram and file, sorted and without duplicates.
+	std::vector<uint64_t> pairs;
+	pairs.reserve(entry.upper_names.size());
+
+	for (unsigned i = 0; i < entry.name_offsets.size(); ++i) {
+		auto name = entry.upper_name(i);
+		for (size_t j = 0; j + 3 <= name.size(); ++j)
+			pairs.push_back((uint64_t(trigram(name.data() + j)) << 32) |
+			                i);
+	}
+
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+	entry.trigram_files.reserve(pairs.size());
+
+	for (auto p : pairs) {
+		auto t = uint32_t(p >> 32);
+		if (entry.trigrams.empty() || entry.trigrams.back() != t) {
+			entry.trigrams.push_back(t);
+			entry.trigram_offsets.push_back(
+			    uint32_t(entry.trigram_files.size()));
+		}
+
+		entry.trigram_files.push_back(uint32_t(p));
+	}
+
+	entry.trigram_offsets.push_back(uint32_t(entry.trigram_files.size()));
+}
+
+void Archive_container::index_basenames(const Archive_entry& entry,
+                                        unsigned archive_index)
+{
+	// The names don't move when the entry does, so the map can point to
+	// them.
+	for (unsigned i = 0; i < entry.name_offsets.size(); ++i)
+		basenames.try_emplace(basename(entry.upper_name(i)),
+		                      File_ref{archive_index, i});
+}
+
+std::string
+Archive_container::cache_filename(const std::string& archive_filename) const
+{
+	std::error_code ec;
+	auto path = fs::absolute(archive_filename, ec).string();
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.idx",
+	         (unsigned long long)fnv1a(path));
+
+	return (fs::path(cache_dir) / name).string();
+}
+
+bool Archive_container::load_cache(Archive_entry& entry) const
+{
+	if (cache_dir.empty())
+		return false;
+
+	uint64_t size;
+	int64_t time;
+	if (!archive_stamp(entry.filename, size, time))
+		return false;
+
+	ifstream in(cache_filename(entry.filename), ios::binary);
+	if (!in)
+		return false;
+
+	in.seekg(0, ios::end);
+	std::vector<char> data(size_t(in.tellg()));
+	in.seekg(0, ios::beg);
+	in.read(data.data(), data.size());
+	if (!in)
+		return false;
+
+	Cache_header header;
+	if (data.size() < sizeof(header))
+		return false;
+
+	memcpy(&header, data.data(), sizeof(header));
+
+	std::error_code ec;
+	auto path = fs::absolute(entry.filename, ec).string();
+
+	if (strncmp(header.signature, "NWZI", 4) != 0 ||
+	    header.version != cache_version || header.archive_size != size ||
+	    header.archive_time != time || header.path_size != path.size() ||
+	    header.file_count == 0 || header.names_size == 0)
+		return false;
+
+	size_t offset = sizeof(header);
+	std::vector<char> cached_path;
+
+	if (!read_array(data, offset, header.file_count, entry.files) ||
+	    !read_array(data, offset, header.file_count, entry.name_offsets) ||
+	    !read_array(data, offset, header.trigram_count, entry.trigrams) ||
+	    !read_array(data, offset, header.trigram_count + size_t(1),
+	                entry.trigram_offsets) ||
+	    !read_array(data, offset, header.trigram_file_count,
+	                entry.trigram_files) ||
+	    !read_array(data, offset, header.path_size, cached_path) ||
+	    !read_array(data, offset, header.names_size, entry.names))
+		return false;
+
+	if (memcmp(cached_path.data(), path.data(), path.size()) != 0 ||
+	    entry.names.back() != '\0')
+		return false;
+
+	// Offsets must increase, so each name is in the buffer.
+	for (size_t i = 0; i < entry.name_offsets.size(); ++i) {
+		auto end = i + 1 < entry.name_offsets.size()
+		               ? entry.name_offsets[i + 1]
+		               : uint32_t(entry.names.size());
+		if (entry.name_offsets[i] >= end)
+			return false;
+	}
+
+	if (!std::is_sorted(entry.trigram_offsets.begin(),
+	                    entry.trigram_offsets.end()) ||
+	    entry.trigram_offsets.back() > entry.trigram_files.size())
+		return false;
+
+	for (auto f : entry.trigram_files)
+		if (f >= header.file_count)
+			return false;
+
+	entry.upper_names.resize(entry.names.size());
+	std::transform(entry.names.begin(), entry.names.end(),
+	               entry.upper_names.begin(),
+	               [](char c) { return to_upper(c); });
+
+	return true;
+}
+
+void Archive_container::save_cache(const Archive_entry& entry) const
+{
+	if (cache_dir.empty() || entry.files.empty())
+		return;
+
+	Cache_header header = {};
+	if (!archive_stamp(entry.filename, header.archive_size,
+	                   header.archive_time))
+		return;
+
+	std::error_code ec;
+	auto path = fs::absolute(entry.filename, ec).string();
+
+	memcpy(header.signature, "NWZI", 4);
+	header.version = cache_version;
+	header.path_size = uint32_t(path.size());
+	header.file_count = uint32_t(entry.files.size());
+	header.names_size = uint32_t(entry.names.size());
+	header.trigram_count = uint32_t(entry.trigrams.size());
+	header.trigram_file_count = uint32_t(entry.trigram_files.size());
+
+	fs::create_directories(cache_dir, ec);
+
+	// Written to a temporary file first, so a concurrent run never reads
+	// a partial cache.
+	auto filename = cache_filename(entry.filename);
+	auto tmp_filename = filename + ".tmp";
+
+	{
+		ofstream out(tmp_filename, ios::binary);
+		if (!out)
+			return;
+
+		out.write((const char*)&header, sizeof(header));
+		write_array(out, entry.files);
+		write_array(out, entry.name_offsets);
+		write_array(out, entry.trigrams);
+		write_array(out, entry.trigram_offsets);
+		write_array(out, entry.trigram_files);
+		out.write(path.data(), path.size());
+		write_array(out, entry.names);
+
+		if (!out)
+			return;
+	}
+
+	fs::rename(tmp_filename, filename, ec);
+	if (ec)
+		fs::remove(tmp_filename, ec);
+}
+
+// Calls f(file_index) for each file whose uppercase name contains str, in
+// increasing order, until f returns false.
+template <typename F>
+void Archive_container::for_each_match(const Archive_entry& entry,
+                                       std::string_view str, F f) const
+{
+	if (str.size() < 3) {
+		// Too short for the trigram index.
+		for (unsigned i = 0; i < entry.name_offsets.size(); ++i) {
+			if (entry.upper_name(i).find(str) != std::string_view::npos &&
+			    !f(i))
+				return;
+		}
+		return;
+	}
+
+	// Find the trigram of str with the fewest files. If one isn't in
+	// the index, nothing matches.
+	const uint32_t* begin = nullptr;
+	const uint32_t* end = nullptr;
+
+	for (size_t i = 0; i + 3 <= str.size(); ++i) {
+		auto t = trigram(str.data() + i);
+		auto it = std::lower_bound(entry.trigrams.begin(),
+		                           entry.trigrams.end(), t);
+		if (it == entry.trigrams.end() || *it != t)
+			return;
+
+		auto k = it - entry.trigrams.begin();
+		auto b = entry.trigram_files.data() + entry.trigram_offsets[k];
+		auto e = entry.trigram_files.data() + entry.trigram_offsets[k + 1];
+
+		if (!begin || e - b < end - begin) {
+			begin = b;
+			end = e;
+		}
+	}
+
+	for (auto p = begin; p != end; ++p) {
+		if (entry.upper_name(*p).find(str) != std::string_view::npos &&
+		    !f(*p))
+			return;
+	}
+}
+
+unsigned Archive_container::archive_count() const
+{
+	return archives.size();
+}
+
+std::string Archive_container::archive_filename(unsigned archive_index) const
+{
+	if (archive_index >= archives.size())
+		return "";
+
+	return archives[archive_index].filename;
+}
+
+unsigned Archive_container::file_count(unsigned archive_index) const
+{
+	if (archive_index >= archives.size())
+		return 0;
+
+	return unsigned(archives[archive_index].files.size());
+}
+
+bool Archive_container::extract_file(unsigned archive_index,
+                                     unsigned file_index,
+                                     const char* dest_filename) const
+{
+	auto info = file_info(archive_index, file_index);
+	if (!info)
+		return false;
+
+	Extraction_context context;
+	auto size = size_t(info->uncomp_size);
+	auto data = context.output.reserve(size);
+	if (!read_file(context, {archive_index, file_index}, data))
+		return false;
+
+	ofstream out(dest_filename, ios::binary);
+	out.write((const char*)data, size);
+
+	return bool(out);
+}
+
+bool Archive_container::extract_file_to_mem(
+    unsigned archive_index, unsigned file_index,
+    std::vector<unsigned char>& buffer) const
+{
+	Extraction_context context;
+	return extract_file_to_mem(archive_index, file_index, buffer, context);
+}
+
+bool Archive_container::extract_file_to_mem(unsigned archive_index,
+                                            unsigned file_index,
+                                            std::vector<unsigned char>& buffer,
+                                            Extraction_context& context) const
+{
+	auto info = file_info(archive_index, file_index);
+	if (!info)
+		return false;
+
+	buffer.resize(info->uncomp_size);
+
+	return read_file(context, {archive_index, file_index}, buffer.data());
+}
+
+bool Archive_container::file_view(unsigned archive_index, unsigned file_index,
+                                  std::span<const unsigned char>& data,
+                                  Extraction_context& context) const
+{
+	auto info = file_info(archive_index, file_index);
+	if (!info)
+		return false;
+
+	auto size = size_t(info->uncomp_size);
+
+	if (info->method == 0) {
+		if (auto stored = stored_data(archive_index, *info)) {
+			data = {stored, size};
+			return true;
+		}
+	}
+
+	auto output = context.output.reserve(size);
+	if (!read_file(context, {archive_index, file_index}, output))
+		return false;
+
+	data = {output, size};
+
+	return true;
+}
+
+// Returns the central directory entry of a file, or nullptr if there's no
+// such file or it can't be extracted.
+const Archive_container::File_info*
+Archive_container::file_info(unsigned archive_index, unsigned file_index) const
+{
+	if (archive_index >= archives.size() ||
+	    file_index >= archives[archive_index].files.size())
+		return nullptr;
+
+	auto& info = archives[archive_index].files[file_index];
+
+	// Encrypted files aren't supported.
+	if ((info.bit_flag & 1) ||
+	    (info.method != 0 && info.method != MZ_DEFLATED) ||
+	    (info.method == 0 && info.comp_size != info.uncomp_size))
+		return nullptr;
+
+	return &info;
+}
+
+// Returns the data of a stored file in the mapping of its archive, or
+// nullptr if the archive can't be mapped.
+const unsigned char* Archive_container::stored_data(unsigned archive_index,
+                                                    const File_info& info) const
+{
+	auto mapping = mapped_file(archive_index);
+	if (!mapping)
+		return nullptr;
+
+	auto size = mapping->size();
+	if (info.local_header_offset > size ||
+	    size - info.local_header_offset < local_header_size)
+		return nullptr;
+
+	auto header = mapping->data() + info.local_header_offset;
+	if (read_le(header, 4) != local_header_signature)
+		return nullptr;
+
+	auto offset = data_offset(header, info.local_header_offset);
+	if (offset > size || size - offset < info.comp_size)
+		return nullptr;
+
+	return mapping->data() + offset;
+}
+
+std::string Archive_container::filename(unsigned archive_index,
+                                        unsigned file_index) const
+{
+	if (archive_index >= archives.size() ||
+	    file_index >= archives[archive_index].name_offsets.size())
+		return "";
+
+	return std::string(archives[archive_index].name(file_index));
+}
+
+bool Archive_container::file_stat(unsigned archive_index, unsigned file_index,
+                                  File_stat& stat) const
+{
+	if (archive_index >= archives.size() ||
+	    file_index >= archives[archive_index].files.size())
+		return false;
+
+	auto& info = archives[archive_index].files[file_index];
+	stat = {info.comp_size, info.uncomp_size, info.crc32,
+	        info.method == MZ_DEFLATED};
+
+	return true;
+}
+
+std::vector<bool> Archive_container::extract_files_to_mem(
+    std::span<const File_ref> files,
+    const std::function<void(size_t, std::vector<unsigned char>&)>& f,
+    unsigned thread_count) const
+{
+	// Requests sorted by archive and by position in the archive.
+	std::vector<size_t> order(files.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	auto offset = [&](const File_ref& ref) -> uint64_t {
+		if (ref.archive_index >= archives.size() ||
+		    ref.file_index >= archives[ref.archive_index].files.size())
+			return 0;
+
+		return archives[ref.archive_index]
+		    .files[ref.file_index]
+		    .local_header_offset;
+	};
+
+	std::sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+		auto& a = files[i];
+		auto& b = files[j];
+		if (a.archive_index != b.archive_index)
+			return a.archive_index < b.archive_index;
+		return offset(a) < offset(b);
+	});
+
+	if (thread_count == 0)
+		thread_count = default_thread_count();
+
+	// Not std::vector<bool>, as threads write to adjacent elements.
+	std::vector<char> extracted(files.size(), false);
+	std::atomic<size_t> next = 0;
+
+	// Each index is a worker with its own context, taking the next
+	// request in order.
+	parallel_for(
+	    0, std::min<size_t>(thread_count, files.size()),
+	    [&](size_t) {
+		    Extraction_context context;
+		    std::vector<unsigned char> data;
+
+		    for (size_t k = next++; k < order.size(); k = next++) {
+			    size_t i = order[k];
+			    auto info = file_info(files[i].archive_index,
+			                          files[i].file_index);
+			    if (!info)
+				    continue;
+
+			    data.resize(info->uncomp_size);
+			    if (!read_file(context, files[i], data.data()))
+				    continue;
+
+			    extracted[i] = true;
+			    f(i, data);
+		    }
+	    },
+	    thread_count);
+
+	return std::vector<bool>(extracted.begin(), extracted.end());
+}
+
+std::vector<bool>
+Archive_container::extract_files(std::span<const File_ref> files,
+                                 std::span<const std::string> dest_filenames,
+                                 unsigned thread_count) const
+{
+	std::vector<char> written(files.size(), false);
+
+	auto extracted = extract_files_to_mem(
+	    files,
+	    [&](size_t i, std::vector<unsigned char>& data) {
+		    ofstream out(dest_filenames[i], ios::binary);
+		    out.write((const char*)data.data(), data.size());
+		    written[i] = bool(out);
+	    },
+	    thread_count);
+
+	for (size_t i = 0; i < files.size(); ++i)
+		extracted[i] = extracted[i] && written[i];
+
+	return extracted;
+}
+
+// Reads a file into dest, which must fit its uncompressed size, with the
+// central directory entry of the index, and checks its CRC.
+bool Archive_container::read_file(Extraction_context& context, File_ref file,
+                                  unsigned char* dest) const
+{
+	auto info = file_info(file.archive_index, file.file_index);
+	if (!info)
+		return false;
+
+	if (context.streams.size() < archives.size())
+		context.streams.resize(archives.size());
+
+	auto& stream = context.streams[file.archive_index];
+	if (!stream) {
+		stream = std::make_unique<std::ifstream>(
+		    archives[file.archive_index].filename, ios::binary);
+		if (!*stream) {
+			stream.reset();
+			return false;
+		}
+	}
+
+	auto& in = *stream;
+	in.clear();
+	in.seekg(info->local_header_offset);
+
+	unsigned char header[local_header_size];
+	in.read((char*)header, sizeof(header));
+	if (!in || read_le(header, 4) != local_header_signature)
+		return false;
+
+	in.seekg(data_offset(header, info->local_header_offset));
+
+	auto size = size_t(info->uncomp_size);
+
+	if (info->method == 0) {
+		in.read((char*)dest, size);
+		if (!in)
+			return false;
+	}
+	else {
+		auto comp_size = size_t(info->comp_size);
+		auto compressed = context.compressed.reserve(comp_size);
+		in.read((char*)compressed, comp_size);
+		if (!in)
+			return false;
+
+		if (!context.inflater ||
+		    context.inflater->backend() != inflate_backend)
+			context.inflater =
+			    std::make_unique<Inflater>(inflate_backend);
+
+		if (!context.inflater->decompress(compressed, comp_size, dest,
+		                                  size))
+			return false;
+	}
+
+	return mz_crc32(MZ_CRC32_INIT, dest, size) == info->crc32;
+}
+
+Archive_container::Find_result
+Archive_container::find_file(const char* str) const
+{
+	Find_result res;
+	res.matches = 0;
+	res.archive_index = archives.size();
+	res.file_index = -1;
+
+	char buffer[MZ_ZIP_MAX_ARCHIVE_FILENAME_SIZE];
+	std::string_view upper;
+	if (!to_upper(str, buffer, upper))
+		return res;
+
+	for (unsigned i = 0; i < archives.size(); ++i) {
+		for_each_match(archives[i], upper, [&](unsigned file_index) {
+			if (res.matches++ == 0) {
+				res.archive_index = i;
+				res.file_index = file_index;
+			}
+			return true;
+		});
+	}
+
+	return res;
+}
+
+Archive_container::Find_result
+Archive_container::find_exact(const char* basename) const
+{
+	Find_result res;
+	res.matches = 0;
+	res.archive_index = archives.size();
+	res.file_index = -1;
+
+	char buffer[MZ_ZIP_MAX_ARCHIVE_FILENAME_SIZE];
+	std::string_view upper;
+	if (!to_upper(basename, buffer, upper))
+		return res;
+
+	auto it = basenames.find(upper);
+	if (it == basenames.end())
+		return res;
+
+	res.matches = 1;
+	res.archive_index = it->second.archive_index;
+	res.file_index = it->second.file_index;
+
+	return res;
+}
+
+std::vector<std::string> Archive_container::find_files(const char* str,
+                                                       size_t max_count) const
+{
+	std::vector<std::string> files;
+
+	char buffer[MZ_ZIP_MAX_ARCHIVE_FILENAME_SIZE];
+	std::string_view upper;
+	if (!to_upper(str, buffer, upper))
+		return files;
+
+	for (unsigned i = 0; i < archives.size(); ++i) {
+		for_each_match(archives[i], upper, [&](unsigned file_index) {
+			if (files.size() >= max_count)
+				return false;
+
+			files.push_back(filename(i, file_index));
+			return true;
+		});
+	}
+
+	return files;
+}
+
+std::vector<std::vector<Archive_container::File_ref>>
+Archive_container::find_duplicates() const
+{
+	struct Key {
+		uint64_t size;
+		uint32_t crc32;
+		File_ref file;
+	};
+
+	std::vector<Key> keys;
+	for (unsigned i = 0; i < archives.size(); ++i) {
+		auto& files = archives[i].files;
+		for (unsigned j = 0; j < files.size(); ++j) {
+			if (files[j].uncomp_size > 0)
+				keys.push_back({files[j].uncomp_size,
+				                files[j].crc32, {i, j}});
+		}
+	}
+
+	// Identical files end up together, in archive order.
+	std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+		if (a.size != b.size)
+			return a.size < b.size;
+		if (a.crc32 != b.crc32)
+			return a.crc32 < b.crc32;
+		if (a.file.archive_index != b.file.archive_index)
+			return a.file.archive_index < b.file.archive_index;
+		return a.file.file_index < b.file.file_index;
+	});
+
+	std::vector<std::vector<File_ref>> groups;
+
+	for (size_t i = 0; i < keys.size();) {
+		size_t j = i + 1;
+		while (j < keys.size() && keys[j].size == keys[i].size &&
+		       keys[j].crc32 == keys[i].crc32)
+			++j;
+
+		if (j - i > 1) {
+			auto& group = groups.emplace_back();
+			for (size_t k = i; k < j; ++k)
+				group.push_back(keys[k].file);
+		}
+
+		i = j;
+	}
+
+	return groups;
+}
@@ -0,0 +1,279 @@
+// Copyright 2017 Jose M. Arbos
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "inflater.h"
+#include "mapped_file.h"
+#include "miniz.h"
+
+/// Group of zip archives searched as one.
+///
+/// The file names of each archive are indexed when it's added, so lookups
+/// don't need to go through the zip central directories:
+///
+/// - Uppercase base names are kept in a hash map for exact lookups.
+/// - The trigrams (three consecutive characters) of the uppercase names
+///   are kept in a sorted index for substring searches. Only the files
+///   with the rarest trigram of the search string are compared.
+///
+/// Searches are case insensitive and don't allocate memory.
+///
+/// If a cache directory is set, the index and the central directory
+/// entries (offsets, sizes and CRCs) of each archive are saved there, keyed
+/// by the archive path, size and modification time. Adding an archive with
+/// a valid cache entry is a single file read, and the zip itself is only
+/// opened when a file is extracted from it.
+class Archive_container {
+public:
+	struct Find_result {
+		unsigned matches;
+		unsigned archive_index;
+		unsigned file_index;
+	};
+
+	/// Location of a file in the container.
+	struct File_ref {
+		unsigned archive_index;
+		unsigned file_index;
+	};
+
+	/// Reusable state to extract files from one thread: a decompressor,
+	/// the streams of the archives, opened on first use, and buffers that
+	/// only grow. Once the buffers fit the largest file, extracting
+	/// through a context doesn't allocate. A context must only be used
+	/// with one container.
+	class Extraction_context {
+	public:
+		Extraction_context();
+		~Extraction_context();
+
+	private:
+		friend class Archive_container;
+
+		/// Not a vector, as resizing it would clear the new elements.
+		struct Buffer {
+			std::unique_ptr<unsigned char[]> data;
+			size_t capacity = 0;
+
+			unsigned char* reserve(size_t size);
+		};
+
+		std::unique_ptr<Inflater> inflater;
+		/// Stream of each archive.
+		std::vector<std::unique_ptr<std::ifstream>> streams;
+		/// Compressed data of the file being extracted.
+		Buffer compressed;
+		/// Data returned by file_view().
+		Buffer output;
+	};
+
+	/// Central directory information of a file.
+	struct File_stat {
+		uint64_t comp_size;
+		uint64_t uncomp_size;
+		uint32_t crc32;
+		/// Whether the file is deflated, or stored otherwise.
+		bool compressed;
+	};
+
+	/// Sets the directory where archive indices are cached. An empty
+	/// string disables the cache.
+	void set_cache_dir(const char* dir);
+
+	/// Sets the decompressor of deflated files. See
+	/// Inflater::default_backend().
+	void set_inflate_backend(Inflater::Backend backend);
+
+	bool add_archive(const char* filename);
+
+	/// Adds several archives, reading their indices concurrently. The
+	/// archives keep the order of the list for searches, as if they were
+	/// added one by one.
+	///
+	/// @param thread_count Maximum number of threads. 0 means one per
+	/// hardware thread.
+	/// @return Whether each archive could be opened.
+	std::vector<bool> add_archives(std::span<const std::string> filenames,
+	                               unsigned thread_count = 0);
+	unsigned archive_count() const;
+	/// Returns the path of an archive, as it was added.
+	std::string archive_filename(unsigned archive_index) const;
+	unsigned file_count(unsigned archive_index) const;
+	bool extract_file(unsigned archive_index, unsigned file_index,
+	                  const char* dest_filename) const;
+	bool extract_file_to_mem(unsigned archive_index, unsigned file_index,
+	                         std::vector<unsigned char> &buffer) const;
+	/// Like extract_file_to_mem() above, but reuses the decompressor and
+	/// the open archives of a context. If buffer is reused too, extracting
+	/// a file doesn't allocate once everything fits.
+	bool extract_file_to_mem(unsigned archive_index, unsigned file_index,
+	                         std::vector<unsigned char>& buffer,
+	                         Extraction_context& context) const;
+	std::string filename(unsigned archive_index, unsigned file_index) const;
+
+	/// Gets the sizes and CRC of a file from the index, without reading
+	/// the archive.
+	bool file_stat(unsigned archive_index, unsigned file_index,
+	               File_stat& stat) const;
+
+	/// Returns the contents of a file, without copying them if possible.
+	///
+	/// For stored (not compressed) files, the archive is memory mapped
+	/// on first use and data points straight into the mapping. It stays
+	/// valid while the container exists, and only the pages that are read
+	/// are loaded, so the CRC isn't checked. Mappings are kept until the
+	/// container is destroyed.
+	///
+	/// Deflated files, and stored files of archives that can't be mapped
+	/// (e.g. for lack of address space in 32-bit builds), are read into
+	/// the output buffer of the context and checked. data stays valid
+	/// until the context is used again.
+	///
+	/// @return Whether the file could be read.
+	bool file_view(unsigned archive_index, unsigned file_index,
+	               std::span<const unsigned char>& data,
+	               Extraction_context& context) const;
+
+	/// Extracts several files to memory concurrently.
+	///
+	/// Each worker thread reads the archives through its own file
+	/// handles, using the central directory entries of the index, so no
+	/// zip reader is shared. Files are handed out in archive and offset
+	/// order, so the reads are mostly sequential, and each one is
+	/// inflated by the thread that read it.
+	///
+	/// @param f Called as f(i, data) from the worker threads when
+	/// files[i] has been extracted. data can be moved from.
+	/// @param thread_count Maximum number of threads. 0 means one per
+	/// hardware thread.
+	/// @return Whether each file could be extracted.
+	std::vector<bool> extract_files_to_mem(
+	    std::span<const File_ref> files,
+	    const std::function<void(size_t, std::vector<unsigned char>&)>& f,
+	    unsigned thread_count = 0) const;
+
+	/// Extracts several files concurrently, files[i] to
+	/// dest_filenames[i]. See extract_files_to_mem().
+	std::vector<bool> extract_files(std::span<const File_ref> files,
+	                                std::span<const std::string> dest_filenames,
+	                                unsigned thread_count = 0) const;
+
+	/// Finds the files whose path contains a string.
+	///
+	/// @return The number of matches, and the archive and file of the
+	/// first one (in the order the archives were added).
+	Find_result find_file(const char* str) const;
+
+	/// Finds a file by its name, without directories.
+	///
+	/// @return One match for the first archive that has the file, or
+	/// zero matches.
+	Find_result find_exact(const char* basename) const;
+
+	/// Returns the paths of the files that contain a string, up to
+	/// max_count. Useful to report ambiguous searches.
+	std::vector<std::string> find_files(const char* str,
+	                                    size_t max_count) const;
+
+	/// Finds the files that are stored more than once, in the same or in
+	/// different archives and with any name.
+	///
+	/// Files are compared by the CRC and the uncompressed size of the
+	/// central directory, so nothing is read or inflated. Files with the
+	/// same CRC and size are identical with high probability, but it
+	/// isn't verified. Empty files are ignored.
+	///
+	/// @return Groups of identical files. The files of each group are in
+	/// the order the archives were added.
+	std::vector<std::vector<File_ref>> find_duplicates() const;
+
+private:
+	/// Central directory entry of a file.
+	struct File_info {
+		uint64_t local_header_offset;
+		uint64_t comp_size;
+		uint64_t uncomp_size;
+		uint32_t crc32;
+		uint16_t method;
+		uint16_t bit_flag;
+	};
+
+	struct Zip_deleter {
+		void operator()(mz_zip_archive* zip) const;
+	};
+
+	struct Archive_entry {
+		std::string filename;
+		/// Mapped on the first view of a stored file.
+		mutable std::unique_ptr<Mapped_file> mapping;
+		/// Guards the creation of the mapping, as files may be viewed
+		/// from several threads. A pointer, so the entry can be moved.
+		std::unique_ptr<std::once_flag> mapping_once =
+		    std::make_unique<std::once_flag>();
+		std::vector<File_info> files;
+		/// File names, each one followed by a null character.
+		std::vector<char> names;
+		/// Uppercase version of names.
+		std::vector<char> upper_names;
+		/// Offset of each file name in names and upper_names.
+		std::vector<uint32_t> name_offsets;
+		/// Sorted distinct trigrams of the file names. The files with
+		/// trigram i are trigram_files[trigram_offsets[i],
+		/// trigram_offsets[i + 1]), in increasing order.
+		std::vector<uint32_t> trigrams;
+		std::vector<uint32_t> trigram_offsets;
+		std::vector<uint32_t> trigram_files;
+
+		std::string_view name(unsigned file_index) const;
+		std::string_view upper_name(unsigned file_index) const;
+	};
+
+	std::string cache_dir;
+	Inflater::Backend inflate_backend = Inflater::default_backend();
+	std::vector<Archive_entry> archives;
+	/// First file with each uppercase base name. The keys point to the
+	/// names of the archives.
+	std::unordered_map<std::string_view, File_ref> basenames;
+
+	const Mapped_file* mapped_file(unsigned archive_index) const;
+	const File_info* file_info(unsigned archive_index,
+	                           unsigned file_index) const;
+	const unsigned char* stored_data(unsigned archive_index,
+	                                 const File_info& info) const;
+	bool load_archive(Archive_entry& entry) const;
+	bool read_file(Extraction_context& context, File_ref file,
+	               unsigned char* dest) const;
+	bool read_central_directory(Archive_entry& entry) const;
+	void build_trigrams(Archive_entry& entry) const;
+	void index_basenames(const Archive_entry& entry, unsigned archive_index);
+	std::string cache_filename(const std::string& archive_filename) const;
+	bool load_cache(Archive_entry& entry) const;
+	void save_cache(const Archive_entry& entry) const;
+
+	template <typename F>
+	void for_each_match(const Archive_entry& entry, std::string_view str,
+	                    F f) const;
+};
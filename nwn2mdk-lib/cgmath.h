@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+
 template <typename T>
 class Vector3 {
 public:
@@ -29,6 +31,51 @@ public:
 
 static_assert(sizeof(Vector3<float>) == 12);
 
+template <typename T>
+Vector3<T> operator+(const Vector3<T>& a, const Vector3<T>& b)
+{
+	return Vector3<T>(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+template <typename T>
+Vector3<T> operator-(const Vector3<T>& a, const Vector3<T>& b)
+{
+	return Vector3<T>(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+template <typename T>
+Vector3<T> operator*(T s, const Vector3<T>& v)
+{
+	return Vector3<T>(s * v.x, s * v.y, s * v.z);
+}
+
+template <typename T>
+T dot(const Vector3<T>& a, const Vector3<T>& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template <typename T>
+Vector3<T> cross(const Vector3<T>& a, const Vector3<T>& b)
+{
+	return Vector3<T>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+	                  a.x * b.y - a.y * b.x);
+}
+
+template <typename T>
+T length(const Vector3<T>& v)
+{
+	return std::sqrt(dot(v, v));
+}
+
+/// Returns a zero vector if v is too short to be normalized.
+template <typename T>
+Vector3<T> normalize(const Vector3<T>& v)
+{
+	T len = length(v);
+	return len > T(1e-20) ? (1 / len) * v : Vector3<T>();
+}
+
 template <typename T>
 class Vector4 {
 public:
@@ -0,0 +1,99 @@
+#include <climits>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "inflater.h"
+// miniz defines zlib names (inflate, z_stream...) as macros otherwise.
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "miniz.h"
+
+Inflater::Inflater(Backend backend)
+        : backend_(backend)
+{
+#ifndef USE_ZLIB
+	backend_ = MINIZ;
+#endif
+}
+
+Inflater::~Inflater()
+{
+#ifdef USE_ZLIB
+	if (state) {
+		auto stream = (z_stream*)state;
+		inflateEnd(stream);
+		delete stream;
+	}
+#endif
+}
+
+bool Inflater::decompress(const void* src, size_t src_size, void* dest,
+                          size_t dest_size)
+{
+#ifdef USE_ZLIB
+	if (backend_ == ZLIB) {
+		// zlib counts bytes with 32-bit integers.
+		if (src_size > UINT_MAX || dest_size > UINT_MAX)
+			return false;
+
+		auto stream = (z_stream*)state;
+		if (!stream) {
+			stream = new z_stream{};
+			// Negative window bits means raw deflate, without
+			// zlib header.
+			if (inflateInit2(stream, -MAX_WBITS) != Z_OK) {
+				delete stream;
+				return false;
+			}
+			state = stream;
+		}
+		else if (inflateReset(stream) != Z_OK)
+			return false;
+
+		stream->next_in = (Bytef*)src;
+		stream->avail_in = uInt(src_size);
+		stream->next_out = (Bytef*)dest;
+		stream->avail_out = uInt(dest_size);
+
+		return ::inflate(stream, Z_FINISH) == Z_STREAM_END &&
+		       stream->total_out == dest_size;
+	}
+#endif
+
+	// The decompressor state is on the stack, so there's nothing to keep
+	// between calls.
+	return tinfl_decompress_mem_to_mem(dest, dest_size, src, src_size, 0) ==
+	       dest_size;
+}
+
+Inflater::Backend Inflater::backend() const
+{
+	return backend_;
+}
+
+const char* Inflater::backend_name(Backend backend)
+{
+	switch (backend) {
+	case MINIZ:
+		return "miniz";
+	case ZLIB:
+		return "zlib";
+	}
+
+	return "";
+}
+
+std::vector<Inflater::Backend> Inflater::available_backends()
+{
+#ifdef USE_ZLIB
+	return {ZLIB, MINIZ};
+#else
+	return {MINIZ};
+#endif
+}
+
+Inflater::Backend Inflater::default_backend()
+{
+	return available_backends().front();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/// Decompressor of raw deflate streams (the data of deflated zip entries).
+///
+/// miniz is always available. Defining USE_ZLIB at build time adds a zlib
+/// backend, which becomes the default. It's meant to be linked against
+/// zlib-ng (built in zlib compatible mode) for its SIMD inflater; stock
+/// zlib isn't faster than miniz. nw2fbx -bench-inflate compares them.
+///
+/// An Inflater keeps its state between calls, so reusing one avoids
+/// allocations. It can't be used from several threads at once.
+class Inflater {
+public:
+	enum Backend { MINIZ, ZLIB };
+
+	Inflater(Backend backend = default_backend());
+	~Inflater();
+
+	Inflater(const Inflater&) = delete;
+	Inflater& operator=(const Inflater&) = delete;
+
+	/// Decompresses a raw deflate stream whose decompressed size is known.
+	///
+	/// @return Whether the stream is valid and decompresses to exactly
+	/// dest_size bytes.
+	bool decompress(const void* src, size_t src_size, void* dest,
+	                size_t dest_size);
+
+	Backend backend() const;
+
+	static const char* backend_name(Backend backend);
+
+	/// Returns the backends compiled in.
+	static std::vector<Backend> available_backends();
+
+	/// Returns zlib if it's compiled in, or miniz otherwise.
+	static Backend default_backend();
+
+private:
+	Backend backend_;
+	/// Backend specific state, created on first use.
+	void* state = nullptr;
+};
@@ -0,0 +1,103 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+
+Mapped_file::Mapped_file(const char* filename)
+{
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+	                          NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+	                          NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		return;
+	}
+
+	size_ = size_t(file_size.QuadPart);
+
+	// Empty files can't be mapped.
+	if (size_ > 0) {
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0,
+		                             NULL);
+		if (mapping)
+			data_ = (const unsigned char*)MapViewOfFile(
+			    mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	// The mapping keeps the file open.
+	CloseHandle(file);
+
+	is_good_ = size_ == 0 || data_;
+}
+
+Mapped_file::~Mapped_file()
+{
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (mapping)
+		CloseHandle(mapping);
+}
+
+#else
+
+Mapped_file::Mapped_file(const char* filename)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return;
+	}
+
+	size_ = size_t(st.st_size);
+
+	// Empty files can't be mapped.
+	if (size_ > 0) {
+		void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+			data_ = (const unsigned char*)p;
+	}
+
+	// The mapping keeps the file open.
+	close(fd);
+
+	is_good_ = size_ == 0 || data_;
+}
+
+Mapped_file::~Mapped_file()
+{
+	if (data_)
+		munmap((void*)data_, size_);
+}
+
+#endif
+
+const unsigned char* Mapped_file::data() const
+{
+	return data_;
+}
+
+size_t Mapped_file::size() const
+{
+	return size_;
+}
+
+Mapped_file::operator bool() const
+{
+	return is_good_;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+/// Read-only memory mapping of a whole file.
+///
+/// Pages are loaded by the operating system when they are first accessed,
+/// so only the parts of the file that are read cost I/O.
+class Mapped_file {
+public:
+	/// Maps the specified file.
+	///
+	/// @param filename The name of the file to be mapped.
+	Mapped_file(const char* filename);
+	~Mapped_file();
+
+	Mapped_file(const Mapped_file&) = delete;
+	Mapped_file& operator=(const Mapped_file&) = delete;
+
+	/// Returns a pointer to the first byte of the file. Empty files
+	/// return nullptr.
+	const unsigned char* data() const;
+
+	/// Returns the size of the file in bytes.
+	size_t size() const;
+
+	/// Checks whether the file was successfully mapped.
+	operator bool() const;
+
+private:
+	const unsigned char* data_ = nullptr;
+	size_t size_ = 0;
+	bool is_good_ = false;
+#ifdef _WIN32
+	/// File mapping HANDLE.
+	void* mapping = nullptr;
+#endif
+};
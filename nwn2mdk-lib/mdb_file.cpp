@@ -15,6 +15,13 @@
 #include <string.h>
 
 #include "mdb_file.h"
+#include "mdb_view.h"
+#include "memstream.h"
+#include "parallel_for.h"
+
+// Below this size, packets are parsed in the calling thread as starting
+// threads would cost more than parsing.
+const size_t parallel_read_min_size = 256 * 1024;
 
 template <typename T>
 static void read(std::istream& in, T& x)
@@ -29,15 +36,19 @@ static void read(std::istream& in, std::vector<T>& v)
 }
 
 template <typename T>
-static void write(std::ostream& out, T& x)
+static unsigned char* write(unsigned char* out, T& x)
 {
-	out.write((char*)&x, sizeof(T));
+	memcpy(out, &x, sizeof(T));
+	return out + sizeof(T);
 }
 
 template <typename T>
-static void write(std::ostream& out, std::vector<T>& v)
+static unsigned char* write(unsigned char* out, std::vector<T>& v)
 {
-	out.write((char*)v.data(), sizeof(T) * v.size());
+	// data() of an empty vector may be null, which memcpy doesn't accept.
+	if (!v.empty())
+		memcpy(out, v.data(), sizeof(T) * v.size());
+	return out + sizeof(T) * v.size();
 }
 
 MDB_file::Walk_mesh_material MDB_file::walk_mesh_materials[] = {
@@ -58,6 +69,8 @@ MDB_file::Walk_mesh_material MDB_file::walk_mesh_materials[] = {
 MDB_file::MDB_file()
 {
 	is_good_ = true;
+	flags = 0;
+	lazy_in = nullptr;
 
 	memcpy(header.signature, "NWN2", 4);
 	header.major_version = 1;
@@ -65,25 +78,64 @@ MDB_file::MDB_file()
 	header.packet_count = 0;
 }
 
-MDB_file::MDB_file(const char* filename)
+MDB_file::MDB_file(const char* filename, uint32_t flags)
 {
 	is_good_ = false;
+	this->flags = flags;
+	lazy_in = nullptr;
 
-	std::ifstream in(filename, std::ios::in | std::ios::binary);
-	if (!in) {
+	auto in = std::make_unique<std::ifstream>(
+	    filename, std::ios::in | std::ios::binary);
+	if (!*in) {
 		error_str_ = "can't open file";
 		return;
 	}
 
-	read(in);
+	if (flags & LAZY_PACKETS) {
+		read(*in);
+
+		// Keep the file open to read the packet data later.
+		lazy_in_owned = std::move(in);
+		return;
+	}
+
+	// Read the whole file at once and parse the packets from memory.
+	in->seekg(0, std::ios::end);
+	auto file_size = in->tellg();
+	in->seekg(0, std::ios::beg);
 
+	if (file_size < 0) {
+		error_str_ = "can't read file";
+		return;
+	}
+
+	std::vector<unsigned char> buffer(static_cast<size_t>(file_size));
+	in->read((char*)buffer.data(), buffer.size());
+
+	if (!*in) {
+		error_str_ = "can't read file";
+		return;
+	}
+
+	read(buffer.data(), buffer.size());
 }
 
-MDB_file::MDB_file(std::istream& in)
+MDB_file::MDB_file(std::istream& in, uint32_t flags)
 {
+	this->flags = flags;
+	lazy_in = nullptr;
+
 	read(in);
 }
 
+MDB_file::MDB_file(const void* data, size_t size, uint32_t flags)
+{
+	this->flags = flags;
+	lazy_in = nullptr;
+
+	read((const unsigned char*)data, size);
+}
+
 void MDB_file::add_packet(std::unique_ptr<Packet> packet)
 {
 	if(!packet)
@@ -95,10 +147,23 @@ void MDB_file::add_packet(std::unique_ptr<Packet> packet)
 	packet_keys.push_back(packet_key);
 
 	packets.push_back(move(packet));
+	packets_loaded.push_back(true);
 
 	++header.packet_count;
 }
 
+void MDB_file::remove_packet(uint32_t packet_index)
+{
+	if (packet_index >= packet_keys.size())
+		return;
+
+	packet_keys.erase(packet_keys.begin() + packet_index);
+	packets.erase(packets.begin() + packet_index);
+	packets_loaded.erase(packets_loaded.begin() + packet_index);
+
+	--header.packet_count;
+}
+
 const char* MDB_file::error_str() const
 {
 	return error_str_.c_str();
@@ -115,6 +180,17 @@ uint16_t MDB_file::minor_version() const
 }
 
 MDB_file::Packet* MDB_file::packet(uint32_t packet_index) const
+{
+	if (packet_index >= packet_keys.size())
+		return nullptr;
+
+	if (!packets_loaded[packet_index])
+		load_packet(packet_index);
+
+	return packets[packet_index].get();
+}
+
+MDB_file::Packet* MDB_file::peek_packet(uint32_t packet_index) const
 {
 	if (packet_index >= packet_keys.size())
 		return nullptr;
@@ -127,76 +203,238 @@ uint32_t MDB_file::packet_count() const
 	return header.packet_count;
 }
 
+void MDB_file::load_packet(uint32_t packet_index) const
+{
+	packets_loaded[packet_index] = true;
+
+	auto& packet = packets[packet_index];
+	if (!packet || !lazy_in)
+		return;
+
+	// Read again the header to position the stream at the packet data.
+	lazy_in->clear();
+	lazy_in->seekg(packet_keys[packet_index].offset);
+	packet->read(*lazy_in);
+
+	// Don't hand out a half-read packet.
+	if (!*lazy_in) {
+		packet.reset();
+		is_good_ = false;
+		error_str_ = "can't read packet " + std::to_string(packet_index);
+	}
+}
+
+std::unique_ptr<MDB_file::Packet> MDB_file::new_packet(const char* type)
+{
+	if (strncmp(type, "COL2", 4) == 0)
+		return std::make_unique<Collision_mesh>(COL2);
+	else if (strncmp(type, "COL3", 4) == 0)
+		return std::make_unique<Collision_mesh>(COL3);
+	else if (strncmp(type, "COLS", 4) == 0)
+		return std::make_unique<Collision_spheres>();
+	else if (strncmp(type, "HAIR", 4) == 0)
+		return std::make_unique<Hair>();
+	else if (strncmp(type, "HELM", 4) == 0)
+		return std::make_unique<Helm>();
+	else if (strncmp(type, "HOOK", 4) == 0)
+		return std::make_unique<Hook>();
+	else if (strncmp(type, "RIGD", 4) == 0)
+		return std::make_unique<Rigid_mesh>();
+	else if (strncmp(type, "SKIN", 4) == 0)
+		return std::make_unique<Skin>();
+	else if (strncmp(type, "WALK", 4) == 0)
+		return std::make_unique<Walk_mesh>();
+
+	return nullptr;
+}
+
 void MDB_file::read(std::istream& in)
 {
 	is_good_ = false;
 
+	if (!read_packet_keys(in))
+		return;
+
+	if (!read_packets(in)) {
+		error_str_ = "truncated file";
+		return;
+	}
+
+	is_good_ = true;
+}
+
+void MDB_file::read(const unsigned char* data, size_t size)
+{
+	is_good_ = false;
+
+	// Packets are parsed from the buffer without further checks, so a
+	// corrupt file mustn't point out of it.
+	MDB_view view(data, size);
+	if (!view) {
+		error_str_ = view.error_str();
+		return;
+	}
+
+	Memstream in(data, size);
+
+	if (!read_packet_keys(in))
+		return;
+
+
+	if (flags & LAZY_PACKETS) {
+		// Packet data is read later from a stream over the buffer.
+		lazy_in_owned = std::make_unique<Memstream>(data, size);
+		if (!read_packets(*lazy_in_owned)) {
+			error_str_ = "truncated file";
+			return;
+		}
+	}
+	else if (!read_packets(data, size))
+		return;
+
+	is_good_ = true;
+}
+
+bool MDB_file::read_packet_keys(std::istream& in)
+{
 	::read(in, header);
 
-	if (strncmp(header.signature, "NWN2", 4) != 0) {
+	if (!in || strncmp(header.signature, "NWN2", 4) != 0) {
 		error_str_ = "invalid file type";
-		return;
+		return false;
 	}
 
 	packet_keys.resize(header.packet_count);
 	::read(in, packet_keys);
 
-	read_packets(in);
-
-	is_good_ = true;
+	return true;
 }
 
-void MDB_file::read_packets(std::istream& in)
+bool MDB_file::read_packets(std::istream& in)
 {
 	for (auto& packet_key : packet_keys)
 		read_packet(packet_key, in);
+
+	if (flags & LAZY_PACKETS)
+		lazy_in = &in;
+
+	return bool(in);
+}
+
+bool MDB_file::read_packets(const unsigned char* data, size_t size)
+{
+	packets.resize(packet_keys.size());
+	packets_loaded.assign(packet_keys.size(), true);
+
+	// Error of each packet, empty if it was read.
+	std::vector<std::string> errors(packet_keys.size());
+
+	// Packets are independent, each one is parsed with its own stream
+	// and stored by index so the order doesn't depend on scheduling.
+	// Exceptions are caught here, as they can't leave a worker thread.
+	auto read_packet = [&](size_t i) {
+		try {
+			Memstream in(data, size);
+			in.seekg(packet_keys[i].offset);
+
+			packets[i] = new_packet(packet_keys[i].type);
+			if (packets[i]) {
+				packets[i]->read(in);
+				if (!in)
+					errors[i] = "truncated";
+			}
+		}
+		catch (const std::exception& e) {
+			errors[i] = e.what();
+		}
+	};
+
+	parallel_for(0, packet_keys.size(), read_packet,
+	             size < parallel_read_min_size ? 1 : 0);
+
+	for (size_t i = 0; i < errors.size(); ++i) {
+		if (!errors[i].empty()) {
+			error_str_ = "can't read packet " + std::to_string(i) +
+			             ": " + errors[i];
+			return false;
+		}
+	}
+
+	return true;
 }
 
 void MDB_file::read_packet(Packet_key& packet_key, std::istream& in)
 {
 	in.seekg(packet_key.offset);
 
-	if (strncmp(packet_key.type, "COL2", 4) == 0)
-		packets.emplace_back(new Collision_mesh(in));
-	else if (strncmp(packet_key.type, "COL3", 4) == 0)
-		packets.emplace_back(new Collision_mesh(in));
-	else if (strncmp(packet_key.type, "COLS", 4) == 0)
-		packets.emplace_back(new Collision_spheres(in));
-	else if (strncmp(packet_key.type, "HAIR", 4) == 0)
-		packets.emplace_back(new Hair(in));
-	else if (strncmp(packet_key.type, "HELM", 4) == 0)
-		packets.emplace_back(new Helm(in));
-	else if (strncmp(packet_key.type, "HOOK", 4) == 0)
-		packets.emplace_back(new Hook(in));
-	else if (strncmp(packet_key.type, "RIGD", 4) == 0)
-		packets.emplace_back(new Rigid_mesh(in));
-	else if (strncmp(packet_key.type, "SKIN", 4) == 0)
-		packets.emplace_back(new Skin(in));
-	else if (strncmp(packet_key.type, "WALK", 4) == 0)
-		packets.emplace_back(new Walk_mesh(in));
-	else
-		packets.push_back(nullptr);
+	auto packet = new_packet(packet_key.type);
+
+	if (!packet)
+		packets_loaded.push_back(true);
+	else if (flags & LAZY_PACKETS) {
+		packet->read_header(in);
+		packets_loaded.push_back(false);
+	}
+	else {
+		packet->read(in);
+		packets_loaded.push_back(true);
+	}
+
+	packets.push_back(move(packet));
 }
 
 void MDB_file::save(const char* filename)
 {
-	header.packet_count = packets.size();
+	auto buffer = save_to_mem();
+	if (buffer.empty())
+		return;
+
+	std::ofstream out(filename, std::ios::binary);
+	out.write((char*)buffer.data(), buffer.size());
+}
+
+std::vector<unsigned char> MDB_file::save_to_mem()
+{
+	for (uint32_t i = 0; i < packets.size(); ++i) {
+		if (!packets_loaded[i])
+			load_packet(i);
+	}
+
+	// A packet whose data couldn't be read would be lost.
+	if (!is_good_)
+		return {};
+
+	// Unsupported packets have no object to serialize, so they are
+	// dropped along with their keys.
+	std::vector<Packet*> saved;
+	std::vector<Packet_key> saved_keys;
+	for (uint32_t i = 0; i < packets.size(); ++i) {
+		if (packets[i]) {
+			saved.push_back(packets[i].get());
+			saved_keys.push_back(packet_keys[i]);
+		}
+	}
+
+	Header saved_header = header;
+	saved_header.packet_count = uint32_t(saved.size());
 
 	uint32_t offset =
-	    sizeof(Header) + sizeof(Packet_key) * packet_keys.size();
+	    sizeof(Header) + sizeof(Packet_key) * saved_keys.size();
 
-	for(unsigned i = 0; i < packet_keys.size(); ++i) {
-		packet_keys[i].offset = offset;
-		offset += packets[i]->packet_size();
+	for (size_t i = 0; i < saved.size(); ++i) {
+		saved_keys[i].offset = offset;
+		offset += saved[i]->packet_size();
 	}
 
-	std::ofstream out(filename, std::ios::binary);
-	out.write((char*)&header, sizeof(Header));
-	out.write((char*)packet_keys.data(),
-	          sizeof(Packet_key) * packet_keys.size());
+	std::vector<unsigned char> buffer(offset);
+
+	auto out = ::write(buffer.data(), saved_header);
+	::write(out, saved_keys);
 
-	for(unsigned i = 0; i < packets.size(); ++i)
-		packets[i]->write(out);
+	for (size_t i = 0; i < saved.size(); ++i)
+		saved[i]->serialize(buffer.data() + saved_keys[i].offset);
+
+	return buffer;
 }
 
 MDB_file::operator bool() const
@@ -232,6 +470,23 @@ const char* MDB_file::Packet::type_str() const
 	return "UNKNOWN";
 }
 
+void MDB_file::Packet::read(std::istream& in)
+{
+	read_header(in);
+	read_data(in);
+}
+
+void MDB_file::Packet::read_data(std::istream&)
+{
+}
+
+void MDB_file::Packet::write(std::ostream& out)
+{
+	std::vector<unsigned char> buffer(packet_size());
+	serialize(buffer.data());
+	out.write((char*)buffer.data(), buffer.size());
+}
+
 MDB_file::Collision_mesh::Collision_mesh(Packet_type t)
 {
 	type = t;
@@ -263,7 +518,7 @@ uint32_t MDB_file::Collision_mesh::packet_size()
 	       sizeof(Face) * faces.size();
 }
 
-void MDB_file::Collision_mesh::read(std::istream& in)
+void MDB_file::Collision_mesh::read_header(std::istream& in)
 {
 	::read(in, header);
 
@@ -271,7 +526,10 @@ void MDB_file::Collision_mesh::read(std::istream& in)
 		type = COL2;
 	else
 		type = COL3;
+}
 
+void MDB_file::Collision_mesh::read_data(std::istream& in)
+{
 	verts.resize(header.vertex_count);
 	::read(in, verts);
 
@@ -279,14 +537,14 @@ void MDB_file::Collision_mesh::read(std::istream& in)
 	::read(in, faces);
 }
 
-void MDB_file::Collision_mesh::write(std::ostream& out)
+void MDB_file::Collision_mesh::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 	header.vertex_count = verts.size();
 	header.face_count = faces.size();
 
-	::write(out, header);
-	::write(out, verts);
+	out = ::write(out, header);
+	out = ::write(out, verts);
 	::write(out, faces);
 }
 
@@ -321,12 +579,15 @@ uint32_t MDB_file::Rigid_mesh::packet_size()
 	       sizeof(Face) * faces.size();
 }
 
-void MDB_file::Rigid_mesh::read(std::istream& in)
+void MDB_file::Rigid_mesh::read_header(std::istream& in)
 {
 	type = RIGD;
 
 	::read(in, header);
+}
 
+void MDB_file::Rigid_mesh::read_data(std::istream& in)
+{
 	verts.resize(header.vertex_count);
 	::read(in, verts);
 
@@ -334,14 +595,14 @@ void MDB_file::Rigid_mesh::read(std::istream& in)
 	::read(in, faces);
 }
 
-void MDB_file::Rigid_mesh::write(std::ostream& out)
+void MDB_file::Rigid_mesh::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 	header.vertex_count = verts.size();
 	header.face_count = faces.size();
 
-	::write(out, header);
-	::write(out, verts);
+	out = ::write(out, header);
+	out = ::write(out, verts);
 	::write(out, faces);
 }
 
@@ -377,12 +638,15 @@ uint32_t MDB_file::Skin::packet_size()
 	       sizeof(Face) * faces.size();
 }
 
-void MDB_file::Skin::read(std::istream& in)
+void MDB_file::Skin::read_header(std::istream& in)
 {
 	type = SKIN;
 
 	::read(in, header);
+}
 
+void MDB_file::Skin::read_data(std::istream& in)
+{
 	verts.resize(header.vertex_count);
 	::read(in, verts);
 
@@ -390,14 +654,14 @@ void MDB_file::Skin::read(std::istream& in)
 	::read(in, faces);
 }
 
-void MDB_file::Skin::write(std::ostream& out)
+void MDB_file::Skin::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 	header.vertex_count = verts.size();
 	header.face_count = faces.size();
 
-	::write(out, header);
-	::write(out, verts);
+	out = ::write(out, header);
+	out = ::write(out, verts);
 	::write(out, faces);
 }
 
@@ -426,14 +690,14 @@ uint32_t MDB_file::Hook::packet_size()
 	return sizeof(Hook_header);
 }
 
-void MDB_file::Hook::read(std::istream& in)
+void MDB_file::Hook::read_header(std::istream& in)
 {
 	type = HOOK;
 
 	::read(in, header);
 }
 
-void MDB_file::Hook::write(std::ostream& out)
+void MDB_file::Hook::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 
@@ -463,12 +727,15 @@ uint32_t MDB_file::Walk_mesh::packet_size()
 	       sizeof(Walk_mesh_face) * faces.size();
 }
 
-void MDB_file::Walk_mesh::read(std::istream& in)
+void MDB_file::Walk_mesh::read_header(std::istream& in)
 {
 	type = WALK;
 
 	::read(in, header);
+}
 
+void MDB_file::Walk_mesh::read_data(std::istream& in)
+{
 	verts.resize(header.vertex_count);
 	::read(in, verts);
 
@@ -476,14 +743,14 @@ void MDB_file::Walk_mesh::read(std::istream& in)
 	::read(in, faces);
 }
 
-void MDB_file::Walk_mesh::write(std::ostream& out)
+void MDB_file::Walk_mesh::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 	header.vertex_count = verts.size();
 	header.face_count = faces.size();
 
-	::write(out, header);
-	::write(out, verts);
+	out = ::write(out, header);
+	out = ::write(out, verts);
 	::write(out, faces);
 }
 
@@ -506,22 +773,25 @@ uint32_t MDB_file::Collision_spheres::packet_size()
 		sizeof(Collision_sphere) * spheres.size();
 }
 
-void MDB_file::Collision_spheres::read(std::istream & in)
+void MDB_file::Collision_spheres::read_header(std::istream& in)
 {
 	type = COLS;
 
 	::read(in, header);
+}
 
+void MDB_file::Collision_spheres::read_data(std::istream& in)
+{
 	spheres.resize(header.sphere_count);
 	::read(in, spheres);
 }
 
-void MDB_file::Collision_spheres::write(std::ostream & out)
+void MDB_file::Collision_spheres::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 
-	::write(out, header);
-	::write(out, spheres);	
+	out = ::write(out, header);
+	::write(out, spheres);
 }
 
 MDB_file::Hair::Hair()
@@ -548,14 +818,14 @@ uint32_t MDB_file::Hair::packet_size()
 	return sizeof(Hair_header);
 }
 
-void MDB_file::Hair::read(std::istream & in)
+void MDB_file::Hair::read_header(std::istream& in)
 {
 	type = HAIR;
 
 	::read(in, header);
 }
 
-void MDB_file::Hair::write(std::ostream & out)
+void MDB_file::Hair::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 
@@ -586,14 +856,14 @@ uint32_t MDB_file::Helm::packet_size()
 	return sizeof(Helm_header);
 }
 
-void MDB_file::Helm::read(std::istream & in)
+void MDB_file::Helm::read_header(std::istream& in)
 {
 	type = HELM;
 
 	::read(in, header);
 }
 
-void MDB_file::Helm::write(std::ostream & out)
+void MDB_file::Helm::serialize(unsigned char* out)
 {
 	header.packet_size = packet_size() - sizeof(Packet_header);
 
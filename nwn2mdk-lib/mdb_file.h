@@ -218,12 +218,22 @@ public:
 	public:
 		Packet_type type;
 
+		virtual ~Packet() = default;
+
 		/// Retuns packet type as string.
 		const char* type_str() const;
 
 		virtual uint32_t packet_size() = 0;
-		virtual void read(std::istream& in) = 0;
-		virtual void write(std::ostream& out) = 0;
+		/// Reads the whole packet (header and data).
+		virtual void read(std::istream& in);
+		/// Reads the fixed-size header of the packet.
+		virtual void read_header(std::istream& in) = 0;
+		/// Reads the data that follows the header (vertices, faces,
+		/// ...). The stream must be positioned just after the header.
+		virtual void read_data(std::istream& in);
+		/// Writes the packet to a buffer of at least packet_size() bytes.
+		virtual void serialize(unsigned char* out) = 0;
+		virtual void write(std::ostream& out);
 	};
 
 	/// Represents a rigid mesh (packet type RIGD).
@@ -237,8 +247,9 @@ public:
 		Rigid_mesh(std::istream& in);
 
 		virtual uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void read_data(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	/// Represents a collision mesh (packet type COL2 or COL3).
@@ -252,8 +263,9 @@ public:
 		Collision_mesh(std::istream& in);
 
 		virtual uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void read_data(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	/// Represents a skin (packet type SKIN).
@@ -267,8 +279,9 @@ public:
 		Skin(std::istream& in);
 
 		virtual uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void read_data(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	/// Represents a hook (packet type HOOK).
@@ -280,8 +293,8 @@ public:
 		Hook(std::istream& in);
 
 		virtual uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	/// Represents a walk mesh (packet type WALK).
@@ -295,8 +308,9 @@ public:
 		Walk_mesh(std::istream& in);
 
 		virtual uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void read_data(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	/// Represents collision spheres (packet type COLS).
@@ -309,8 +323,9 @@ public:
 		Collision_spheres(std::istream& in);
 
 		uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void read_data(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	class Hair : public Packet {
@@ -321,8 +336,8 @@ public:
 		Hair(std::istream& in);
 
 		uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	class Helm : public Packet {
@@ -333,8 +348,8 @@ public:
 		Helm(std::istream& in);
 
 		uint32_t packet_size() override;
-		void read(std::istream& in) override;
-		void write(std::ostream& out) override;
+		void read_header(std::istream& in) override;
+		void serialize(unsigned char* out) override;
 	};
 
 	struct Walk_mesh_material {
@@ -345,22 +360,52 @@ public:
 
 	static Walk_mesh_material walk_mesh_materials[12];
 
+	enum Read_flags {
+		/// Only the packet headers are read when the MDB is opened.
+		/// Vertices, faces, etc. are read the first time the packet is
+		/// requested with packet(). As packet() then reads from a
+		/// shared stream and updates the MDB_file, even through a const
+		/// reference, a MDB_file opened with this flag must not be
+		/// shared between threads.
+		LAZY_PACKETS = 0x01
+	};
+
 	/// Constructs an empty MDB.
 	MDB_file();
 
 	/// Opens a MDB file at the specified path.
 	///
 	/// @param filename The name of the file to be opened.
-	MDB_file(const char* filename);
+	/// @param flags Combination of Read_flags.
+	MDB_file(const char* filename, uint32_t flags = 0);
 
 	/// Reads a MDB from a stream.
-	MDB_file(std::istream& in);
+	///
+	/// @param in The stream. With LAZY_PACKETS it must outlive the
+	/// MDB_file, as packet data is read from it on demand.
+	/// @param flags Combination of Read_flags.
+	MDB_file(std::istream& in, uint32_t flags = 0);
+
+	/// Reads a MDB from a buffer. Packets are located by their offsets and
+	/// parsed concurrently. The offsets and sizes of the packets are
+	/// checked against the buffer first, as MDB_view does.
+	///
+	/// @param data Pointer to the first byte of the MDB. With LAZY_PACKETS
+	/// the buffer must outlive the MDB_file.
+	/// @param size Size of the buffer in bytes.
+	/// @param flags Combination of Read_flags.
+	MDB_file(const void* data, size_t size, uint32_t flags = 0);
 
 	/// Adds a packet.
 	///
 	/// @param The packet to add.
 	void add_packet(std::unique_ptr<Packet> packet);
 
+	/// Removes a packet. The packets after it move down one index.
+	///
+	/// @param packet_index The index of the packet to remove.
+	void remove_packet(uint32_t packet_index);
+
 	/// Returns the error string.
 	const char* error_str() const;
 
@@ -370,24 +415,44 @@ public:
 	/// Returns the minor version of the MDB file.
 	uint16_t minor_version() const;
 
-	/// Returns a pointer to the specified packet.
+	/// Returns a pointer to the specified packet. If the MDB was opened
+	/// with LAZY_PACKETS, the packet data is read on first access. If
+	/// that read fails, the packet is discarded and the MDB_file is no
+	/// longer good.
+	///
+	/// @return If specified packet exists and could be read, returns a
+	/// pointer to the packet. Otherwise, returns null pointer.
+	Packet* packet(uint32_t packet_index) const;
+
+	/// Returns a pointer to the specified packet without reading its
+	/// data. Only the header is guaranteed to be valid, vertices, faces,
+	/// etc. may be empty if the MDB was opened with LAZY_PACKETS.
 	///
 	/// @return If specified packet exists, returns a pointer to the
 	/// packet. Otherwise, returns null pointer.
-	Packet* packet(uint32_t packet_index) const;
+	Packet* peek_packet(uint32_t packet_index) const;
 
 	/// Returns the number of packets contained in the MDB file.
 	uint32_t packet_count() const;
 
-	/// Saves to a file.
+	/// Saves to a file. Nothing is written if save_to_mem() fails.
 	///
 	/// @param filename The name of the file.
 	void save(const char* filename);
 
+	/// Saves to a buffer in memory. The buffer is allocated once with the
+	/// size of the whole file. Unsupported packets are left out.
+	///
+	/// @return The contents of the MDB file, or an empty buffer if the
+	/// data of a packet couldn't be read (see packet()).
+	std::vector<unsigned char> save_to_mem();
+
 	/// Checks if no error has occurred.
 	operator bool() const;
 
 private:
+	friend class MDB_view;
+
 	struct Header {
 		char signature[4]; // Should be "NWN2"
 		uint16_t major_version;
@@ -420,13 +485,27 @@ private:
 	static_assert(sizeof(Walk_mesh_header) == 52);
 	static_assert(sizeof(Walk_mesh_vertex) == 12);
 
-	bool is_good_;
-	std::string error_str_;
+	/// Mutable, as packets read later by packet() can fail.
+	mutable bool is_good_;
+	mutable std::string error_str_;
+	uint32_t flags;
 	Header header;
 	std::vector<Packet_key> packet_keys;
-	std::vector<std::unique_ptr<Packet>> packets;
+	mutable std::vector<std::unique_ptr<Packet>> packets;
+	/// Whether the data of each packet has been read (LAZY_PACKETS).
+	mutable std::vector<bool> packets_loaded;
+	/// Stream the packet data is read from (LAZY_PACKETS).
+	std::istream* lazy_in;
+	/// Set when the stream is opened by the MDB_file itself.
+	std::unique_ptr<std::istream> lazy_in_owned;
+
+	static std::unique_ptr<Packet> new_packet(const char* type);
 
+	void load_packet(uint32_t packet_index) const;
 	void read(std::istream& in);
-	void read_packets(std::istream& in);
+	void read(const unsigned char* data, size_t size);
+	bool read_packet_keys(std::istream& in);
+	bool read_packets(std::istream& in);
+	bool read_packets(const unsigned char* data, size_t size);
 	void read_packet(Packet_key& packet_key, std::istream& in);
 };
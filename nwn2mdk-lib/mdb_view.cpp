@@ -0,0 +1,292 @@
+#include <string.h>
+
+#include "mdb_view.h"
+
+static bool packet_type(const char* type_str, MDB_file::Packet_type& type)
+{
+	if (strncmp(type_str, "COL2", 4) == 0)
+		type = MDB_file::COL2;
+	else if (strncmp(type_str, "COL3", 4) == 0)
+		type = MDB_file::COL3;
+	else if (strncmp(type_str, "COLS", 4) == 0)
+		type = MDB_file::COLS;
+	else if (strncmp(type_str, "HAIR", 4) == 0)
+		type = MDB_file::HAIR;
+	else if (strncmp(type_str, "HELM", 4) == 0)
+		type = MDB_file::HELM;
+	else if (strncmp(type_str, "HOOK", 4) == 0)
+		type = MDB_file::HOOK;
+	else if (strncmp(type_str, "RIGD", 4) == 0)
+		type = MDB_file::RIGD;
+	else if (strncmp(type_str, "SKIN", 4) == 0)
+		type = MDB_file::SKIN;
+	else if (strncmp(type_str, "WALK", 4) == 0)
+		type = MDB_file::WALK;
+	else
+		return false;
+
+	return true;
+}
+
+// Copies a header out of the buffer. Packets aren't necessarily aligned,
+// so headers are never read in place.
+template <typename Header>
+static Header read_header(const unsigned char* p)
+{
+	Header h;
+	memcpy(&h, p, sizeof(Header));
+	return h;
+}
+
+// Size in bytes of a packet with a header, vertices and faces.
+template <typename Header, typename Vertex, typename Face>
+static uint64_t mesh_size(const unsigned char* p)
+{
+	auto h = read_header<Header>(p);
+	return sizeof(Header) + uint64_t(sizeof(Vertex)) * h.vertex_count +
+	       uint64_t(sizeof(Face)) * h.face_count;
+}
+
+MDB_view::MDB_view(const void* data, size_t size)
+        : data((const unsigned char*)data)
+        , size(size)
+{
+	read();
+}
+
+MDB_view::MDB_view(std::vector<unsigned char> buffer)
+        : buffer(std::move(buffer))
+{
+	data = this->buffer.data();
+	size = this->buffer.size();
+
+	read();
+}
+
+const char* MDB_view::error_str() const
+{
+	return error_str_.c_str();
+}
+
+uint16_t MDB_view::major_version() const
+{
+	return header.major_version;
+}
+
+uint16_t MDB_view::minor_version() const
+{
+	return header.minor_version;
+}
+
+uint32_t MDB_view::packet_count() const
+{
+	return uint32_t(packets.size());
+}
+
+const MDB_view::Packet* MDB_view::packet(uint32_t packet_index) const
+{
+	if (packet_index >= packets.size() || !packets[packet_index].data)
+		return nullptr;
+
+	return &packets[packet_index];
+}
+
+MDB_view::Collision_mesh MDB_view::collision_mesh(uint32_t packet_index) const
+{
+	return mesh<Collision_mesh>(packet_index, MDB_file::COL2,
+	                            MDB_file::COL3);
+}
+
+MDB_view::Rigid_mesh MDB_view::rigid_mesh(uint32_t packet_index) const
+{
+	return mesh<Rigid_mesh>(packet_index, MDB_file::RIGD, MDB_file::RIGD);
+}
+
+MDB_view::Skin MDB_view::skin(uint32_t packet_index) const
+{
+	return mesh<Skin>(packet_index, MDB_file::SKIN, MDB_file::SKIN);
+}
+
+MDB_view::Walk_mesh MDB_view::walk_mesh(uint32_t packet_index) const
+{
+	return mesh<Walk_mesh>(packet_index, MDB_file::WALK, MDB_file::WALK);
+}
+
+MDB_view::Array<MDB_file::Collision_sphere>
+MDB_view::collision_spheres(uint32_t packet_index) const
+{
+	MDB_file::Collision_spheres_header h;
+	if (!packet_header(packet_index, MDB_file::COLS, h))
+		return {};
+
+	return {packets[packet_index].data + sizeof(h), h.sphere_count};
+}
+
+bool MDB_view::hook(uint32_t packet_index, MDB_file::Hook_header& hook) const
+{
+	return packet_header(packet_index, MDB_file::HOOK, hook);
+}
+
+bool MDB_view::hair(uint32_t packet_index, MDB_file::Hair_header& hair) const
+{
+	return packet_header(packet_index, MDB_file::HAIR, hair);
+}
+
+bool MDB_view::helm(uint32_t packet_index, MDB_file::Helm_header& helm) const
+{
+	return packet_header(packet_index, MDB_file::HELM, helm);
+}
+
+MDB_view::operator bool() const
+{
+	return is_good_;
+}
+
+void MDB_view::read()
+{
+	is_good_ = false;
+	header = {};
+
+	if (size < sizeof(MDB_file::Header)) {
+		error_str_ = "file too small";
+		return;
+	}
+
+	header = read_header<MDB_file::Header>(data);
+
+	if (strncmp(header.signature, "NWN2", 4) != 0) {
+		error_str_ = "invalid file type";
+		return;
+	}
+
+	if (uint64_t(sizeof(MDB_file::Packet_key)) * header.packet_count >
+	    size - sizeof(MDB_file::Header)) {
+		error_str_ = "packet table out of bounds";
+		return;
+	}
+
+	auto packet_keys = data + sizeof(MDB_file::Header);
+
+	packets.reserve(header.packet_count);
+
+	for (uint32_t i = 0; i < header.packet_count; ++i) {
+		auto key = read_header<MDB_file::Packet_key>(
+		    packet_keys + i * sizeof(MDB_file::Packet_key));
+		if (!read_packet(key)) {
+			error_str_ = "packet " + std::to_string(i) +
+			             " out of bounds";
+			return;
+		}
+	}
+
+	is_good_ = true;
+}
+
+bool MDB_view::read_packet(const MDB_file::Packet_key& packet_key)
+{
+	Packet packet = {MDB_file::TRRN, {}, nullptr};
+
+	if (!packet_type(packet_key.type, packet.type)) {
+		// Unsupported packets are kept as null packets, as MDB_file
+		// does.
+		packets.push_back(packet);
+		return true;
+	}
+
+	if (packet_key.offset > size ||
+	    size - packet_key.offset < sizeof(MDB_file::Packet_header))
+		return false;
+
+	auto p = data + packet_key.offset;
+	size_t available = size - packet_key.offset;
+	uint64_t required = 0;
+
+	switch (packet.type) {
+	case MDB_file::COL2:
+	case MDB_file::COL3:
+		if (available < sizeof(MDB_file::Collision_mesh_header))
+			return false;
+		required = mesh_size<MDB_file::Collision_mesh_header,
+		                     MDB_file::Collision_mesh_vertex,
+		                     MDB_file::Face>(p);
+		break;
+	case MDB_file::COLS:
+		if (available < sizeof(MDB_file::Collision_spheres_header))
+			return false;
+		required = sizeof(MDB_file::Collision_spheres_header) +
+		           uint64_t(sizeof(MDB_file::Collision_sphere)) *
+		           read_header<MDB_file::Collision_spheres_header>(p)
+		               .sphere_count;
+		break;
+	case MDB_file::HAIR:
+		required = sizeof(MDB_file::Hair_header);
+		break;
+	case MDB_file::HELM:
+		required = sizeof(MDB_file::Helm_header);
+		break;
+	case MDB_file::HOOK:
+		required = sizeof(MDB_file::Hook_header);
+		break;
+	case MDB_file::RIGD:
+		if (available < sizeof(MDB_file::Rigid_mesh_header))
+			return false;
+		required = mesh_size<MDB_file::Rigid_mesh_header,
+		                     MDB_file::Rigid_mesh_vertex,
+		                     MDB_file::Face>(p);
+		break;
+	case MDB_file::SKIN:
+		if (available < sizeof(MDB_file::Skin_header))
+			return false;
+		required = mesh_size<MDB_file::Skin_header,
+		                     MDB_file::Skin_vertex, MDB_file::Face>(p);
+		break;
+	case MDB_file::WALK:
+		if (available < sizeof(MDB_file::Walk_mesh_header))
+			return false;
+		required = mesh_size<MDB_file::Walk_mesh_header,
+		                     MDB_file::Walk_mesh_vertex,
+		                     MDB_file::Walk_mesh_face>(p);
+		break;
+	default:
+		break;
+	}
+
+	if (required > available)
+		return false;
+
+	packet.header = read_header<MDB_file::Packet_header>(p);
+	packet.data = p;
+	packets.push_back(packet);
+
+	return true;
+}
+
+template <typename M>
+M MDB_view::mesh(uint32_t packet_index, MDB_file::Packet_type type1,
+                 MDB_file::Packet_type type2) const
+{
+	using Header = typename M::Header_type;
+	using Vertex = typename M::Vertex_type;
+
+	auto p = packet(packet_index);
+	if (!p || (p->type != type1 && p->type != type2))
+		return {};
+
+	auto h = read_header<Header>(p->data);
+	auto verts = p->data + sizeof(Header);
+	auto faces = verts + sizeof(Vertex) * h.vertex_count;
+
+	return {h, {verts, h.vertex_count}, {faces, h.face_count}, true};
+}
+
+template <typename T>
+bool MDB_view::packet_header(uint32_t packet_index, MDB_file::Packet_type type,
+                             T& packet_header) const
+{
+	auto p = packet(packet_index);
+	if (!p || p->type != type)
+		return false;
+
+	packet_header = read_header<T>(p->data);
+	return true;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+#include "mdb_file.h"
+
+/// Read-only view of a MDB file stored in a contiguous buffer.
+///
+/// Unlike MDB_file, the arrays aren't copied: vertices and faces are read
+/// straight from the bytes of the buffer. Packets in a MDB aren't aligned
+/// (faces are 6 bytes), so headers are returned by value and array
+/// elements are copied out one at a time on access. All the packets are
+/// bounds checked when the view is constructed, so the accessors can be
+/// used without further checks.
+///
+/// The buffer can be owned by the view or borrowed from the caller (e.g. a
+/// memory mapped file or an archive entry extracted to memory). A borrowed
+/// buffer must outlive the view.
+class MDB_view {
+public:
+	/// Array of elements at any alignment within the buffer.
+	template <typename T>
+	class Array {
+	public:
+		class Iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = T;
+
+			Iterator() = default;
+			explicit Iterator(const unsigned char* p) : p(p) {}
+
+			T operator*() const { return load(p); }
+
+			Iterator& operator++()
+			{
+				p += sizeof(T);
+				return *this;
+			}
+
+			Iterator operator++(int)
+			{
+				auto it = *this;
+				p += sizeof(T);
+				return it;
+			}
+
+			bool operator==(const Iterator&) const = default;
+
+		private:
+			const unsigned char* p = nullptr;
+		};
+
+		Array() = default;
+		Array(const unsigned char* data, size_t count)
+		        : data(data), count(count)
+		{
+		}
+
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+
+		/// Returns a copy of an element.
+		T operator[](size_t i) const { return load(data + i * sizeof(T)); }
+
+		Iterator begin() const { return Iterator(data); }
+		Iterator end() const { return Iterator(data + count * sizeof(T)); }
+
+		/// Returns the bytes of the elements, e.g. to copy them at once
+		/// to an aligned array.
+		std::span<const unsigned char> bytes() const
+		{
+			return {data, count * sizeof(T)};
+		}
+
+	private:
+		const unsigned char* data = nullptr;
+		size_t count = 0;
+
+		static T load(const unsigned char* p)
+		{
+			T x;
+			memcpy(&x, p, sizeof(T));
+			return x;
+		}
+	};
+
+	/// A packet whose data has a header, vertices and faces.
+	template <typename Header, typename Vertex, typename Face>
+	struct Mesh {
+		using Header_type = Header;
+		using Vertex_type = Vertex;
+		using Face_type = Face;
+
+		Header header;
+		Array<Vertex> verts;
+		Array<Face> faces;
+		bool valid = false;
+
+		/// Checks if the packet is of the requested type.
+		operator bool() const { return valid; }
+	};
+
+	using Collision_mesh =
+	    Mesh<MDB_file::Collision_mesh_header,
+	         MDB_file::Collision_mesh_vertex, MDB_file::Face>;
+	using Rigid_mesh = Mesh<MDB_file::Rigid_mesh_header,
+	                        MDB_file::Rigid_mesh_vertex, MDB_file::Face>;
+	using Skin =
+	    Mesh<MDB_file::Skin_header, MDB_file::Skin_vertex, MDB_file::Face>;
+	using Walk_mesh =
+	    Mesh<MDB_file::Walk_mesh_header, MDB_file::Walk_mesh_vertex,
+	         MDB_file::Walk_mesh_face>;
+
+	struct Packet {
+		MDB_file::Packet_type type;
+		MDB_file::Packet_header header;
+		/// Points to the first byte of the packet within the buffer. It
+		/// isn't necessarily aligned.
+		const unsigned char* data;
+	};
+
+	/// Creates a view over a buffer owned by the caller.
+	///
+	/// @param data Pointer to the first byte of the MDB.
+	/// @param size Size of the buffer in bytes.
+	MDB_view(const void* data, size_t size);
+
+	/// Creates a view that takes ownership of the buffer.
+	MDB_view(std::vector<unsigned char> buffer);
+
+	MDB_view(const MDB_view&) = delete;
+	MDB_view& operator=(const MDB_view&) = delete;
+
+	/// Returns the error string.
+	const char* error_str() const;
+
+	/// Returns the major version of the MDB file.
+	uint16_t major_version() const;
+
+	/// Returns the minor version of the MDB file.
+	uint16_t minor_version() const;
+
+	/// Returns the number of packets contained in the MDB file.
+	uint32_t packet_count() const;
+
+	/// Returns the type and the header of the specified packet.
+	///
+	/// @return If specified packet exists and has a known type, returns a
+	/// pointer to the packet. Otherwise, returns null pointer.
+	const Packet* packet(uint32_t packet_index) const;
+
+	/// Returns the specified packet as a collision mesh (COL2 or COL3).
+	///
+	/// @return If the packet doesn't exist or it's of another type, the
+	/// returned mesh evaluates to false.
+	Collision_mesh collision_mesh(uint32_t packet_index) const;
+
+	/// Returns the specified packet as a rigid mesh (RIGD).
+	Rigid_mesh rigid_mesh(uint32_t packet_index) const;
+
+	/// Returns the specified packet as a skin (SKIN).
+	Skin skin(uint32_t packet_index) const;
+
+	/// Returns the specified packet as a walk mesh (WALK).
+	Walk_mesh walk_mesh(uint32_t packet_index) const;
+
+	/// Returns the collision spheres of the specified packet (COLS).
+	Array<MDB_file::Collision_sphere>
+	collision_spheres(uint32_t packet_index) const;
+
+	/// Copies the header of the specified hook packet (HOOK).
+	///
+	/// @return False if the packet doesn't exist or it's of another type.
+	bool hook(uint32_t packet_index, MDB_file::Hook_header& hook) const;
+
+	/// Copies the header of the specified hair packet (HAIR).
+	bool hair(uint32_t packet_index, MDB_file::Hair_header& hair) const;
+
+	/// Copies the header of the specified helm packet (HELM).
+	bool helm(uint32_t packet_index, MDB_file::Helm_header& helm) const;
+
+	/// Checks if no error has occurred.
+	operator bool() const;
+
+private:
+	std::vector<unsigned char> buffer;
+	const unsigned char* data;
+	size_t size;
+	bool is_good_;
+	std::string error_str_;
+	MDB_file::Header header;
+	std::vector<Packet> packets;
+
+	void read();
+	bool read_packet(const MDB_file::Packet_key& packet_key);
+
+	template <typename M>
+	M mesh(uint32_t packet_index, MDB_file::Packet_type type1,
+	       MDB_file::Packet_type type2) const;
+
+	template <typename T>
+	bool packet_header(uint32_t packet_index, MDB_file::Packet_type type,
+	                   T& packet_header) const;
+};
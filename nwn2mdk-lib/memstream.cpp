@@ -10,12 +10,20 @@ Membuf::Membuf(char* begin, char* end)
 Membuf::pos_type Membuf::seekoff(off_type off, std::ios_base::seekdir dir,
                                  std::ios_base::openmode which)
 {
+	off_type base;
 	if (dir == std::ios_base::cur)
-		gbump(off);
+		base = gptr() - begin;
 	else if (dir == std::ios_base::end)
-		setg(begin, end + off, end);
-	else if (dir == std::ios_base::beg)
-		setg(begin, begin + off, end);
+		base = end - begin;
+	else
+		base = 0;
+
+	// Positions outside the buffer fail, as with files, instead of
+	// moving the get pointer out of it.
+	if (off < -base || off > (end - begin) - base)
+		return pos_type(off_type(-1));
+
+	setg(begin, begin + base + off, end);
 
 	return gptr() - eback();
 }
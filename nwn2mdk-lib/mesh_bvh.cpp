@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <cmath>
+
+#include "mesh_bvh.h"
+#include "parallel_for.h"
+
+// Triangles per leaf below which a node isn't split.
+const uint32_t bvh_leaf_size = 4;
+// Number of bins used to evaluate the surface area heuristic.
+const int bvh_bin_count = 16;
+// Deep enough for any mesh with 16-bit indices, even a degenerate one.
+const unsigned bvh_max_depth = 48;
+// Rays or points processed by a thread at a time in batch queries.
+const size_t bvh_query_block_size = 256;
+
+const Mesh_bvh::Face_filter Mesh_bvh::walkable = {0x01, 0x01};
+
+namespace {
+
+struct Bounds {
+	Vector3<float> min{INFINITY, INFINITY, INFINITY};
+	Vector3<float> max{-INFINITY, -INFINITY, -INFINITY};
+
+	void extend(const Vector3<float>& p)
+	{
+		min = Vector3<float>(std::min(min.x, p.x), std::min(min.y, p.y),
+		                     std::min(min.z, p.z));
+		max = Vector3<float>(std::max(max.x, p.x), std::max(max.y, p.y),
+		                     std::max(max.z, p.z));
+	}
+
+	void extend(const Bounds& b)
+	{
+		extend(b.min);
+		extend(b.max);
+	}
+
+	float area() const
+	{
+		if (min.x > max.x)
+			return 0;
+
+		Vector3<float> d = max - min;
+		return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+};
+
+} // namespace
+
+static uint16_t face_flags(const MDB_file::Face&)
+{
+	return 0;
+}
+
+static uint16_t face_flags(const MDB_file::Walk_mesh_face& face)
+{
+	return face.flags[0];
+}
+
+// Distance along the ray to the entry point of the box, or INFINITY if the
+// ray misses it before max_distance.
+static float ray_box_distance(const Vector3<float>& origin,
+                              const Vector3<float>& inv_dir,
+                              const Vector3<float>& min,
+                              const Vector3<float>& max, float max_distance)
+{
+	float t_min = 0;
+	float t_max = max_distance;
+
+	for (int i = 0; i < 3; ++i) {
+		float o = (&origin.x)[i];
+		float inv = (&inv_dir.x)[i];
+		float lo = (&min.x)[i];
+		float hi = (&max.x)[i];
+
+		// A ray parallel to the slab never enters or leaves it. Its
+		// distances would be 0 * inf = NaN when it lies on a plane of
+		// the slab, as face_at() rays do on grid lines.
+		if (std::isinf(inv)) {
+			if (o < lo || o > hi)
+				return INFINITY;
+			continue;
+		}
+
+		float t1 = (lo - o) * inv;
+		float t2 = (hi - o) * inv;
+
+		t_min = std::max(t_min, std::min(t1, t2));
+		t_max = std::min(t_max, std::max(t1, t2));
+	}
+
+	return t_min <= t_max ? t_min : INFINITY;
+}
+
+// Möller-Trumbore ray-triangle intersection. Triangles are two-sided.
+static bool ray_triangle(const Vector3<float>& origin,
+                         const Vector3<float>& dir, const Vector3<float>& v0,
+                         const Vector3<float>& v1, const Vector3<float>& v2,
+                         float& t)
+{
+	Vector3<float> e1 = v1 - v0;
+	Vector3<float> e2 = v2 - v0;
+	Vector3<float> p = cross(dir, e2);
+	float det = dot(e1, p);
+
+	if (det == 0)
+		return false;
+
+	float inv_det = 1 / det;
+	Vector3<float> s = origin - v0;
+	float u = dot(s, p) * inv_det;
+	if (u < 0 || u > 1)
+		return false;
+
+	Vector3<float> q = cross(s, e1);
+	float v = dot(dir, q) * inv_det;
+	if (v < 0 || u + v > 1)
+		return false;
+
+	t = dot(e2, q) * inv_det;
+
+	return t >= 0;
+}
+
+// Closest point on a triangle (Ericson, Real-Time Collision Detection).
+static Vector3<float> closest_point_triangle(const Vector3<float>& p,
+                                             const Vector3<float>& a,
+                                             const Vector3<float>& b,
+                                             const Vector3<float>& c)
+{
+	Vector3<float> ab = b - a;
+	Vector3<float> ac = c - a;
+	Vector3<float> ap = p - a;
+	float d1 = dot(ab, ap);
+	float d2 = dot(ac, ap);
+	if (d1 <= 0 && d2 <= 0)
+		return a;
+
+	Vector3<float> bp = p - b;
+	float d3 = dot(ab, bp);
+	float d4 = dot(ac, bp);
+	if (d3 >= 0 && d4 <= d3)
+		return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + (d1 / (d1 - d3)) * ab;
+
+	Vector3<float> cp = p - c;
+	float d5 = dot(ab, cp);
+	float d6 = dot(ac, cp);
+	if (d6 >= 0 && d5 <= d6)
+		return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + (d2 / (d2 - d6)) * ac;
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+
+	float denom = 1 / (va + vb + vc);
+	return a + (vb * denom) * ab + (vc * denom) * ac;
+}
+
+static float point_box_distance_squared(const Vector3<float>& p,
+                                        const Vector3<float>& min,
+                                        const Vector3<float>& max)
+{
+	float d = 0;
+
+	for (int i = 0; i < 3; ++i) {
+		float v = (&p.x)[i];
+		float e = std::max({(&min.x)[i] - v, 0.0f, v - (&max.x)[i]});
+		d += e * e;
+	}
+
+	return d;
+}
+
+Mesh_bvh::Mesh_bvh(const MDB_file::Walk_mesh& walk_mesh)
+{
+	build(std::span<const MDB_file::Walk_mesh_vertex>(walk_mesh.verts),
+	      std::span<const MDB_file::Walk_mesh_face>(walk_mesh.faces));
+}
+
+Mesh_bvh::Mesh_bvh(const MDB_file::Collision_mesh& collision_mesh)
+{
+	build(std::span<const MDB_file::Collision_mesh_vertex>(
+	          collision_mesh.verts),
+	      std::span<const MDB_file::Face>(collision_mesh.faces));
+}
+
+size_t Mesh_bvh::face_count() const
+{
+	return triangles.size();
+}
+
+template <typename Vertex, typename Face>
+void Mesh_bvh::build(std::span<const Vertex> verts,
+                     std::span<const Face> faces)
+{
+	triangles.reserve(faces.size());
+
+	for (uint32_t i = 0; i < faces.size(); ++i) {
+		auto& f = faces[i];
+		if (f.vertex_indices[0] >= verts.size() ||
+		    f.vertex_indices[1] >= verts.size() ||
+		    f.vertex_indices[2] >= verts.size())
+			continue;
+
+		triangles.push_back({verts[f.vertex_indices[0]].position,
+		                     verts[f.vertex_indices[1]].position,
+		                     verts[f.vertex_indices[2]].position, i,
+		                     face_flags(f)});
+	}
+
+	if (triangles.empty())
+		return;
+
+	std::vector<Vector3<float>> centroids(triangles.size());
+	for (size_t i = 0; i < triangles.size(); ++i) {
+		auto& t = triangles[i];
+		centroids[i] = (1.0f / 3) * (t.v0 + t.v1 + t.v2);
+	}
+
+	nodes.reserve(2 * triangles.size() / bvh_leaf_size + 1);
+	build_node(0, uint32_t(triangles.size()), centroids, 0);
+}
+
+uint32_t Mesh_bvh::build_node(uint32_t first, uint32_t count,
+                              std::vector<Vector3<float>>& centroids,
+                              unsigned depth)
+{
+	uint32_t node_index = uint32_t(nodes.size());
+	nodes.emplace_back();
+
+	Bounds bounds, centroid_bounds;
+	for (uint32_t i = first; i < first + count; ++i) {
+		bounds.extend(triangles[i].v0);
+		bounds.extend(triangles[i].v1);
+		bounds.extend(triangles[i].v2);
+		centroid_bounds.extend(centroids[i]);
+	}
+
+	nodes[node_index].min = bounds.min;
+	nodes[node_index].max = bounds.max;
+	nodes[node_index].index = first;
+	nodes[node_index].count = count;
+
+	if (count <= bvh_leaf_size || depth >= bvh_max_depth)
+		return node_index;
+
+	// Find the best split plane among the bin boundaries of each axis.
+	float best_cost = bounds.area() * count;
+	int best_axis = -1;
+	int best_bin = 0;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		float lo = (&centroid_bounds.min.x)[axis];
+		float hi = (&centroid_bounds.max.x)[axis];
+		if (lo == hi)
+			continue;
+
+		Bounds bins[bvh_bin_count];
+		uint32_t bin_counts[bvh_bin_count] = {};
+		float scale = bvh_bin_count / (hi - lo);
+
+		for (uint32_t i = first; i < first + count; ++i) {
+			int b = std::min(bvh_bin_count - 1,
+			                 int(((&centroids[i].x)[axis] - lo) * scale));
+			++bin_counts[b];
+			bins[b].extend(triangles[i].v0);
+			bins[b].extend(triangles[i].v1);
+			bins[b].extend(triangles[i].v2);
+		}
+
+		// Areas and counts to the right of each boundary.
+		float right_areas[bvh_bin_count];
+		uint32_t right_counts[bvh_bin_count];
+		Bounds right;
+		uint32_t right_count = 0;
+		for (int b = bvh_bin_count - 1; b > 0; --b) {
+			right.extend(bins[b]);
+			right_count += bin_counts[b];
+			right_areas[b] = right.area();
+			right_counts[b] = right_count;
+		}
+
+		Bounds left;
+		uint32_t left_count = 0;
+		for (int b = 1; b < bvh_bin_count; ++b) {
+			left.extend(bins[b - 1]);
+			left_count += bin_counts[b - 1];
+
+			float cost = left.area() * left_count +
+			             right_areas[b] * right_counts[b];
+			if (cost < best_cost && left_count > 0 &&
+			    right_counts[b] > 0) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = b;
+			}
+		}
+	}
+
+	if (best_axis < 0)
+		return node_index;
+
+	float lo = (&centroid_bounds.min.x)[best_axis];
+	float hi = (&centroid_bounds.max.x)[best_axis];
+	float scale = bvh_bin_count / (hi - lo);
+
+	// Partition the triangles (and their centroids) by the split plane.
+	uint32_t mid = first;
+	for (uint32_t i = first; i < first + count; ++i) {
+		int b = std::min(bvh_bin_count - 1,
+		                 int(((&centroids[i].x)[best_axis] - lo) * scale));
+		if (b < best_bin) {
+			std::swap(triangles[i], triangles[mid]);
+			std::swap(centroids[i], centroids[mid]);
+			++mid;
+		}
+	}
+
+	nodes[node_index].count = 0;
+	build_node(first, mid - first, centroids, depth + 1);
+	nodes[node_index].index =
+	    build_node(mid, first + count - mid, centroids, depth + 1);
+
+	return node_index;
+}
+
+Mesh_bvh::Hit Mesh_bvh::raycast(const Ray& ray, Face_filter filter) const
+{
+	Hit hit;
+	if (nodes.empty())
+		return hit;
+
+	Vector3<float> inv_dir(1 / ray.direction.x, 1 / ray.direction.y,
+	                       1 / ray.direction.z);
+	float best = ray.max_distance;
+
+	uint32_t stack[bvh_max_depth * 2 + 2];
+	unsigned stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0) {
+		const Node& node = nodes[stack[--stack_size]];
+
+		if (ray_box_distance(ray.origin, inv_dir, node.min, node.max,
+		                     best) == INFINITY)
+			continue;
+
+		if (node.count > 0) {
+			for (uint32_t i = node.index; i < node.index + node.count;
+			     ++i) {
+				auto& tri = triangles[i];
+				float t;
+				if (filter.accepts(tri.flags) &&
+				    ray_triangle(ray.origin, ray.direction, tri.v0,
+				                 tri.v1, tri.v2, t) &&
+				    t <= best) {
+					// Ties go to the lowest face index, so the
+					// result doesn't depend on the tree layout.
+					if (t < best || tri.face < hit.face) {
+						best = t;
+						hit.face = tri.face;
+					}
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearest child first.
+		uint32_t left = uint32_t(&node - nodes.data()) + 1;
+		uint32_t right = node.index;
+		float d_left = ray_box_distance(ray.origin, inv_dir,
+		                                nodes[left].min, nodes[left].max,
+		                                best);
+		float d_right = ray_box_distance(ray.origin, inv_dir,
+		                                 nodes[right].min,
+		                                 nodes[right].max, best);
+
+		if (d_left > d_right)
+			std::swap(left, right), std::swap(d_left, d_right);
+
+		if (d_right != INFINITY)
+			stack[stack_size++] = right;
+		if (d_left != INFINITY)
+			stack[stack_size++] = left;
+	}
+
+	if (hit) {
+		hit.distance = best;
+		hit.point = ray.origin + best * ray.direction;
+	}
+
+	return hit;
+}
+
+Mesh_bvh::Hit Mesh_bvh::closest_point(const Vector3<float>& p,
+                                      float max_distance,
+                                      Face_filter filter) const
+{
+	Hit hit;
+	if (nodes.empty())
+		return hit;
+
+	float best_squared = max_distance * max_distance;
+
+	uint32_t stack[bvh_max_depth * 2 + 2];
+	unsigned stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0) {
+		const Node& node = nodes[stack[--stack_size]];
+
+		if (point_box_distance_squared(p, node.min, node.max) >
+		    best_squared)
+			continue;
+
+		if (node.count > 0) {
+			for (uint32_t i = node.index; i < node.index + node.count;
+			     ++i) {
+				auto& tri = triangles[i];
+				if (!filter.accepts(tri.flags))
+					continue;
+
+				Vector3<float> q = closest_point_triangle(
+				    p, tri.v0, tri.v1, tri.v2);
+				Vector3<float> d = q - p;
+				float d_squared = dot(d, d);
+
+				if (d_squared < best_squared ||
+				    (d_squared == best_squared &&
+				     tri.face < hit.face)) {
+					best_squared = d_squared;
+					hit.face = tri.face;
+					hit.point = q;
+				}
+			}
+			continue;
+		}
+
+		uint32_t left = uint32_t(&node - nodes.data()) + 1;
+		uint32_t right = node.index;
+		float d_left = point_box_distance_squared(p, nodes[left].min,
+		                                          nodes[left].max);
+		float d_right = point_box_distance_squared(p, nodes[right].min,
+		                                           nodes[right].max);
+
+		if (d_left > d_right)
+			std::swap(left, right), std::swap(d_left, d_right);
+
+		if (d_right <= best_squared)
+			stack[stack_size++] = right;
+		if (d_left <= best_squared)
+			stack[stack_size++] = left;
+	}
+
+	if (hit)
+		hit.distance = std::sqrt(best_squared);
+
+	return hit;
+}
+
+Mesh_bvh::Hit Mesh_bvh::face_at(float x, float y, Face_filter filter) const
+{
+	if (nodes.empty())
+		return {};
+
+	// Cast a ray down from above the whole mesh.
+	Ray ray;
+	ray.origin = Vector3<float>(x, y, nodes[0].max.z + 1);
+	ray.direction = Vector3<float>(0, 0, -1);
+
+	return raycast(ray, filter);
+}
+
+void Mesh_bvh::raycast(std::span<const Ray> rays, std::span<Hit> hits,
+                       Face_filter filter, unsigned thread_count) const
+{
+	size_t n = std::min(rays.size(), hits.size());
+
+	parallel_for_blocks(
+	    0, n, bvh_query_block_size,
+	    [&](size_t begin, size_t end) {
+		    for (size_t i = begin; i < end; ++i)
+			    hits[i] = raycast(rays[i], filter);
+	    },
+	    thread_count);
+}
+
+void Mesh_bvh::closest_points(std::span<const Vector3<float>> points,
+                              std::span<Hit> hits, float max_distance,
+                              Face_filter filter,
+                              unsigned thread_count) const
+{
+	size_t n = std::min(points.size(), hits.size());
+
+	parallel_for_blocks(
+	    0, n, bvh_query_block_size,
+	    [&](size_t begin, size_t end) {
+		    for (size_t i = begin; i < end; ++i)
+			    hits[i] = closest_point(points[i], max_distance,
+			                            filter);
+	    },
+	    thread_count);
+}
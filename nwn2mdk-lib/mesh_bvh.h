@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "cgmath.h"
+#include "mdb_file.h"
+
+/// Bounding volume hierarchy over the faces of a walk mesh or a collision
+/// mesh, for ray casts and proximity queries.
+///
+/// The tree is built with the surface area heuristic and stored as a flat
+/// array of 32-byte nodes in depth-first order, and the triangles are
+/// copied in leaf order, so traversals read memory mostly forward. The
+/// BVH doesn't reference the packet after construction.
+///
+/// Queries are const and can run concurrently from several threads.
+class Mesh_bvh {
+public:
+	/// Value of the face index when a query found nothing.
+	static const uint32_t no_face = UINT32_MAX;
+
+	/// Selects faces by their flags (see MDB_file::Walk_mesh_face and
+	/// MDB_file::walk_mesh_materials). A face is accepted if
+	/// (flags & mask) == value. A zero-initialized filter ({}) accepts all
+	/// the faces. Faces of collision meshes have flags 0.
+	struct Face_filter {
+		uint16_t mask;
+		uint16_t value;
+
+		bool accepts(uint16_t flags) const
+		{
+			return (flags & mask) == value;
+		}
+	};
+
+	/// Accepts walkable faces of any material.
+	static const Face_filter walkable;
+
+	struct Ray {
+		Vector3<float> origin;
+		/// Doesn't need to be normalized. Distances are measured in
+		/// units of its length.
+		Vector3<float> direction;
+		float max_distance = INFINITY;
+	};
+
+	struct Hit {
+		/// Index of the face in the packet, or no_face.
+		uint32_t face = no_face;
+		/// Distance along the ray, or from the query point.
+		float distance = INFINITY;
+		Vector3<float> point;
+
+		operator bool() const { return face != no_face; }
+	};
+
+	/// Builds the BVH over a walk mesh, keeping the face flags.
+	Mesh_bvh(const MDB_file::Walk_mesh& walk_mesh);
+
+	/// Builds the BVH over a collision mesh (COL2 or COL3).
+	Mesh_bvh(const MDB_file::Collision_mesh& collision_mesh);
+
+	/// Returns the nearest face hit by the ray. Faces are two-sided.
+	Hit raycast(const Ray& ray, Face_filter filter = {}) const;
+
+	/// Returns the point on the faces closest to p, if it's within
+	/// max_distance.
+	Hit closest_point(const Vector3<float>& p,
+	                  float max_distance = INFINITY,
+	                  Face_filter filter = {}) const;
+
+	/// Returns the highest face accepted by the filter at the XY
+	/// position, e.g. to find where a creature stands on a walk mesh.
+	Hit face_at(float x, float y, Face_filter filter = walkable) const;
+
+	/// Casts several rays, distributing them among threads.
+	///
+	/// @param hits Must have the same size as rays.
+	/// @param thread_count Maximum number of threads. 0 means one per
+	/// hardware thread.
+	void raycast(std::span<const Ray> rays, std::span<Hit> hits,
+	             Face_filter filter = {}, unsigned thread_count = 0) const;
+
+	/// Finds the closest points of several points, distributing them
+	/// among threads.
+	///
+	/// @param hits Must have the same size as points.
+	void closest_points(std::span<const Vector3<float>> points,
+	                    std::span<Hit> hits, float max_distance = INFINITY,
+	                    Face_filter filter = {},
+	                    unsigned thread_count = 0) const;
+
+	/// Returns the number of faces.
+	size_t face_count() const;
+
+private:
+	struct Node {
+		Vector3<float> min;
+		/// Leaves: first triangle. Inner nodes: right child (the left
+		/// child is the next node).
+		uint32_t index;
+		Vector3<float> max;
+		/// Number of triangles. 0 for inner nodes.
+		uint32_t count;
+	};
+
+	static_assert(sizeof(Node) == 32);
+
+	struct Triangle {
+		Vector3<float> v0, v1, v2;
+		uint32_t face;
+		uint16_t flags;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+
+	template <typename Vertex, typename Face>
+	void build(std::span<const Vertex> verts, std::span<const Face> faces);
+	uint32_t build_node(uint32_t first, uint32_t count,
+	                    std::vector<Vector3<float>>& centroids,
+	                    unsigned depth);
+};
@@ -0,0 +1,603 @@
+#include <algorithm>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_decimator.h"
+
+namespace {
+
+/// Symmetric 4x4 matrix of a quadric error metric: the sum of the
+/// squared distances to a set of planes, weighted by their area.
+struct Quadric {
+	double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+	double weight;
+};
+
+enum class Vertex_kind {
+	/// Interior vertex with a single set of attributes.
+	manifold,
+	/// Vertex on the open border of the mesh.
+	border,
+	/// Vertex with two sets of attributes on a seam line.
+	seam,
+	/// Anything else (seam ends, non-manifold vertices, ...). It's never
+	/// moved.
+	locked
+};
+
+/// Faces using a directed edge between two positions.
+struct Half_edge {
+	uint32_t count;
+	/// Vertices of the first face using the edge.
+	uint32_t from;
+	uint32_t to;
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	float error;
+};
+
+struct Position_hash {
+	size_t operator()(const Vector3<float>& p) const
+	{
+		return std::hash<std::string_view>()(
+		    std::string_view((const char*)&p, sizeof(p)));
+	}
+};
+
+struct Position_equal {
+	bool operator()(const Vector3<float>& p1, const Vector3<float>& p2) const
+	{
+		return memcmp(&p1, &p2, sizeof(p1)) == 0;
+	}
+};
+
+} // namespace
+
+// Weight of the planes that keep borders and seams in place, relative to
+// the planes of the faces.
+const double border_weight = 10;
+
+// Collapses that turn a face more than this (cosine of the angle) are
+// rejected, as they fold the surface.
+const float min_face_turn = 0.25f;
+
+static void add_plane(Quadric& q, const Vector3<float>& normal,
+                      const Vector3<float>& point, double weight)
+{
+	double a = normal.x;
+	double b = normal.y;
+	double c = normal.z;
+	double d = -(a * point.x + b * point.y + c * point.z);
+
+	q.xx += weight * a * a;
+	q.xy += weight * a * b;
+	q.xz += weight * a * c;
+	q.xw += weight * a * d;
+	q.yy += weight * b * b;
+	q.yz += weight * b * c;
+	q.yw += weight * b * d;
+	q.zz += weight * c * c;
+	q.zw += weight * c * d;
+	q.ww += weight * d * d;
+	q.weight += weight;
+}
+
+static void add_quadric(Quadric& q, const Quadric& r)
+{
+	q.xx += r.xx;
+	q.xy += r.xy;
+	q.xz += r.xz;
+	q.xw += r.xw;
+	q.yy += r.yy;
+	q.yz += r.yz;
+	q.yw += r.yw;
+	q.zz += r.zz;
+	q.zw += r.zw;
+	q.ww += r.ww;
+	q.weight += r.weight;
+}
+
+// Returns the weighted mean of the squared distances from p to the planes
+// of two quadrics.
+static float quadric_error(const Quadric& q, const Quadric& r,
+                           const Vector3<float>& p)
+{
+	double x = p.x;
+	double y = p.y;
+	double z = p.z;
+	double e = (q.xx + r.xx) * x * x + (q.yy + r.yy) * y * y +
+	           (q.zz + r.zz) * z * z +
+	           2 * ((q.xy + r.xy) * x * y + (q.xz + r.xz) * x * z +
+	                (q.yz + r.yz) * y * z) +
+	           2 * ((q.xw + r.xw) * x + (q.yw + r.yw) * y +
+	                (q.zw + r.zw) * z) +
+	           (q.ww + r.ww);
+	double w = q.weight + r.weight;
+
+	return w > 0 ? float(std::max(e, 0.0) / w) : 0;
+}
+
+static uint64_t edge_key(uint32_t a, uint32_t b)
+{
+	return (uint64_t(a) << 32) | b;
+}
+
+template <typename T>
+static const Vector3<float>& position(const T& mesh, uint32_t v)
+{
+	return mesh.verts[v].position;
+}
+
+template <typename T>
+static Vector3<float> face_normal(const T& mesh, const MDB_file::Face& face)
+{
+	auto& p0 = position(mesh, face.vertex_indices[0]);
+	auto& p1 = position(mesh, face.vertex_indices[1]);
+	auto& p2 = position(mesh, face.vertex_indices[2]);
+
+	return cross(p1 - p0, p2 - p0);
+}
+
+// Returns, for each vertex, the index of the first vertex at the same
+// position. Vertices at the same position move together.
+template <typename T>
+static std::vector<uint32_t> position_ids(const T& mesh)
+{
+	std::unordered_map<Vector3<float>, uint32_t, Position_hash,
+	                   Position_equal>
+	    first;
+	first.reserve(mesh.verts.size());
+
+	std::vector<uint32_t> ids(mesh.verts.size());
+	for (uint32_t i = 0; i < mesh.verts.size(); ++i)
+		ids[i] = first.try_emplace(position(mesh, i), i).first->second;
+
+	return ids;
+}
+
+namespace {
+
+/// Connectivity of the current faces, in terms of positions.
+struct Topology {
+	std::unordered_map<uint64_t, Half_edge> edges;
+	std::vector<Vertex_kind> kinds;
+	/// Sorted neighbour positions of each position.
+	std::vector<std::vector<uint32_t>> neighbours;
+	/// Faces around each position.
+	std::vector<std::vector<uint32_t>> faces;
+
+	/// Checks if the edge between two positions has a face on one side
+	/// only.
+	bool is_border(uint32_t p, uint32_t q) const
+	{
+		return edges.find(edge_key(p, q)) == edges.end() ||
+		       edges.find(edge_key(q, p)) == edges.end();
+	}
+};
+
+} // namespace
+
+template <typename Faces>
+static Topology analyze(const Faces& faces, const std::vector<uint32_t>& ids)
+{
+	Topology topo;
+	size_t n = ids.size();
+
+	topo.edges.reserve(faces.size() * 3);
+	topo.neighbours.resize(n);
+	topo.faces.resize(n);
+
+	// Distinct vertices used at each position.
+	std::vector<uint32_t> wedges[2];
+	wedges[0].assign(n, UINT32_MAX);
+	wedges[1].assign(n, UINT32_MAX);
+	std::vector<uint32_t> wedge_count(n, 0);
+
+	for (uint32_t f = 0; f < faces.size(); ++f) {
+		auto& face = faces[f];
+
+		for (int i = 0; i < 3; ++i) {
+			uint32_t a = face.vertex_indices[i];
+			uint32_t b = face.vertex_indices[(i + 1) % 3];
+			uint32_t p = ids[a];
+			uint32_t q = ids[b];
+
+			auto r = topo.edges.try_emplace(edge_key(p, q),
+			                                Half_edge{0, a, b});
+			++r.first->second.count;
+
+			topo.neighbours[p].push_back(q);
+			topo.neighbours[q].push_back(p);
+			topo.faces[p].push_back(f);
+
+			if (wedges[0][p] == a || wedges[1][p] == a)
+				continue;
+
+			if (wedge_count[p] < 2)
+				wedges[wedge_count[p]][p] = a;
+			++wedge_count[p];
+		}
+	}
+
+	// Border and seam edges around each position. Both are counted once
+	// per half-edge and endpoint.
+	std::vector<uint32_t> border(n, 0);
+	std::vector<uint32_t> seam(n, 0);
+	std::vector<bool> non_manifold(n, false);
+
+	for (auto& [key, e] : topo.edges) {
+		uint32_t p = uint32_t(key >> 32);
+		uint32_t q = uint32_t(key);
+
+		auto opposite = topo.edges.find(edge_key(q, p));
+
+		if (e.count > 1 ||
+		    (opposite != topo.edges.end() && opposite->second.count > 1)) {
+			non_manifold[p] = true;
+			non_manifold[q] = true;
+		}
+		else if (opposite == topo.edges.end()) {
+			++border[p];
+			++border[q];
+		}
+		else if (opposite->second.from != e.to ||
+		         opposite->second.to != e.from) {
+			++seam[p];
+			++seam[q];
+		}
+	}
+
+	topo.kinds.resize(n);
+
+	for (uint32_t p = 0; p < n; ++p) {
+		auto& nb = topo.neighbours[p];
+		std::sort(nb.begin(), nb.end());
+		nb.erase(std::unique(nb.begin(), nb.end()), nb.end());
+
+		if (non_manifold[p])
+			topo.kinds[p] = Vertex_kind::locked;
+		else if (wedge_count[p] == 1 && border[p] == 0 && seam[p] == 0)
+			topo.kinds[p] = Vertex_kind::manifold;
+		else if (wedge_count[p] == 1 && border[p] == 2 && seam[p] == 0)
+			topo.kinds[p] = Vertex_kind::border;
+		else if (wedge_count[p] == 2 && border[p] == 0 && seam[p] == 4)
+			topo.kinds[p] = Vertex_kind::seam;
+		else
+			topo.kinds[p] = Vertex_kind::locked;
+	}
+
+	return topo;
+}
+
+// Adds the planes that keep the border and seam edges of the mesh in
+// place: planes through the edge, perpendicular to its face.
+template <typename T>
+static void add_edge_planes(const T& mesh, const std::vector<uint32_t>& ids,
+                            const Topology& topo,
+                            std::vector<Quadric>& quadrics)
+{
+	for (auto& face : mesh.faces) {
+		auto normal = normalize(face_normal(mesh, face));
+
+		for (int i = 0; i < 3; ++i) {
+			uint32_t a = face.vertex_indices[i];
+			uint32_t b = face.vertex_indices[(i + 1) % 3];
+			uint32_t p = ids[a];
+			uint32_t q = ids[b];
+
+			auto opposite = topo.edges.find(edge_key(q, p));
+			if (opposite != topo.edges.end() &&
+			    opposite->second.from == b && opposite->second.to == a)
+				continue; // Smooth edge.
+
+			auto edge = position(mesh, b) - position(mesh, a);
+			auto plane_normal = normalize(cross(edge, normal));
+			double weight = border_weight * dot(edge, edge);
+
+			add_plane(quadrics[p], plane_normal, position(mesh, a),
+			          weight);
+			add_plane(quadrics[q], plane_normal, position(mesh, a),
+			          weight);
+		}
+	}
+}
+
+// Finds the vertex the other copy of a seam vertex moves to when the
+// vertex "from" collapses onto "to".
+//
+// @return False if the seam doesn't run along the edge.
+static bool seam_pair(const Topology& topo, const std::vector<uint32_t>& ids,
+                      uint32_t from, uint32_t to, uint32_t& from2,
+                      uint32_t& to2)
+{
+	uint32_t p = ids[from];
+	uint32_t q = ids[to];
+
+	auto e1 = topo.edges.find(edge_key(p, q));
+	auto e2 = topo.edges.find(edge_key(q, p));
+	if (e1 == topo.edges.end() || e2 == topo.edges.end())
+		return false;
+
+	if (e1->second.from == from && e1->second.to == to) {
+		from2 = e2->second.to;
+		to2 = e2->second.from;
+	}
+	else if (e2->second.to == from && e2->second.from == to) {
+		from2 = e1->second.from;
+		to2 = e1->second.to;
+	}
+	else {
+		return false;
+	}
+
+	// Both copies must be different on each side of the seam.
+	return from2 != from && to2 != to;
+}
+
+static bool can_collapse(const Topology& topo,
+                         const std::vector<uint32_t>& ids, uint32_t from,
+                         uint32_t to)
+{
+	uint32_t p = ids[from];
+	uint32_t q = ids[to];
+	uint32_t from2, to2;
+
+	if (p == q)
+		return false;
+
+	switch (topo.kinds[p]) {
+	case Vertex_kind::manifold:
+		return true;
+	case Vertex_kind::border:
+		return topo.is_border(p, q);
+	case Vertex_kind::seam:
+		return !topo.is_border(p, q) &&
+		       seam_pair(topo, ids, from, to, from2, to2);
+	default:
+		return false;
+	}
+}
+
+// Checks that collapsing position p onto q keeps the mesh manifold: both
+// may only share the vertices opposite to the edge.
+static bool link_condition(const Topology& topo, uint32_t p, uint32_t q)
+{
+	auto& np = topo.neighbours[p];
+	auto& nq = topo.neighbours[q];
+	size_t shared = 0;
+
+	for (auto i = np.begin(), j = nq.begin(); i != np.end() && j != nq.end();) {
+		if (*i < *j)
+			++i;
+		else if (*j < *i)
+			++j;
+		else {
+			++shared;
+			++i;
+			++j;
+		}
+	}
+
+	return shared <= (topo.is_border(p, q) ? 1u : 2u);
+}
+
+// Checks that no face around p turns too much when p moves to q.
+template <typename T>
+static bool keeps_orientation(const T& mesh, const std::vector<uint32_t>& ids,
+                              const Topology& topo, uint32_t p, uint32_t q)
+{
+	for (uint32_t f : topo.faces[p]) {
+		auto& face = mesh.faces[f];
+		Vector3<float> points[3];
+		bool collapses = false;
+
+		for (int i = 0; i < 3; ++i) {
+			uint32_t r = ids[face.vertex_indices[i]];
+			collapses |= r == q;
+			points[i] = position(mesh, r == p ? q : r);
+		}
+
+		if (collapses)
+			continue;
+
+		auto n0 = face_normal(mesh, face);
+		auto n1 = cross(points[1] - points[0], points[2] - points[0]);
+
+		if (dot(n0, n1) <= min_face_turn * length(n0) * length(n1))
+			return false;
+	}
+
+	return true;
+}
+
+template <typename T>
+static void remove_unused_vertices(T& mesh)
+{
+	const uint32_t unused = UINT32_MAX;
+	std::vector<uint32_t> remap(mesh.verts.size(), unused);
+
+	for (auto& face : mesh.faces)
+		for (int i = 0; i < 3; ++i)
+			remap[face.vertex_indices[i]] = 0;
+
+	uint32_t next = 0;
+	for (uint32_t v = 0; v < mesh.verts.size(); ++v) {
+		if (remap[v] == unused)
+			continue;
+
+		remap[v] = next;
+		mesh.verts[next++] = mesh.verts[v];
+	}
+	mesh.verts.resize(next);
+
+	for (auto& face : mesh.faces)
+		for (int i = 0; i < 3; ++i)
+			face.vertex_indices[i] =
+			    uint16_t(remap[face.vertex_indices[i]]);
+}
+
+template <typename T>
+static size_t decimate(T& mesh, size_t target_face_count, float max_error)
+{
+	for (auto& face : mesh.faces)
+		for (int i = 0; i < 3; ++i)
+			if (face.vertex_indices[i] >= mesh.verts.size())
+				return mesh.faces.size();
+
+	if (mesh.faces.size() <= target_face_count)
+		return mesh.faces.size();
+
+	auto ids = position_ids(mesh);
+
+	// Quadrics are stored per position, at the index of its first
+	// vertex.
+	std::vector<Quadric> quadrics(mesh.verts.size(), Quadric{});
+
+	for (auto& face : mesh.faces) {
+		auto normal = face_normal(mesh, face);
+		double area = length(normal) / 2;
+		if (area == 0)
+			continue;
+
+		normal = normalize(normal);
+		for (int i = 0; i < 3; ++i)
+			add_plane(quadrics[ids[face.vertex_indices[i]]], normal,
+			          position(mesh, face.vertex_indices[0]), area);
+	}
+
+	add_edge_planes(mesh, ids, analyze(mesh.faces, ids), quadrics);
+
+	float max_error_sq = max_error * max_error;
+	std::vector<uint32_t> remap(mesh.verts.size());
+	std::vector<bool> locked(mesh.verts.size());
+
+	// Each pass collapses the cheapest edges whose neighbourhoods don't
+	// overlap, so the checks done before a collapse remain valid.
+	while (mesh.faces.size() > target_face_count) {
+		auto topo = analyze(mesh.faces, ids);
+
+		std::vector<Collapse> collapses;
+		collapses.reserve(mesh.faces.size() * 3);
+
+		for (auto& face : mesh.faces) {
+			for (int i = 0; i < 3; ++i) {
+				uint32_t a = face.vertex_indices[i];
+				uint32_t b = face.vertex_indices[(i + 1) % 3];
+
+				if (can_collapse(topo, ids, a, b))
+					collapses.push_back(
+					    {a, b,
+					     quadric_error(quadrics[ids[a]],
+					                   quadrics[ids[b]],
+					                   position(mesh, b))});
+
+				if (can_collapse(topo, ids, b, a))
+					collapses.push_back(
+					    {b, a,
+					     quadric_error(quadrics[ids[b]],
+					                   quadrics[ids[a]],
+					                   position(mesh, a))});
+			}
+		}
+
+		std::stable_sort(collapses.begin(), collapses.end(),
+		                 [](const Collapse& c1, const Collapse& c2) {
+			                 return c1.error < c2.error;
+		                 });
+
+		for (uint32_t v = 0; v < remap.size(); ++v)
+			remap[v] = v;
+		std::fill(locked.begin(), locked.end(), false);
+
+		size_t face_count = mesh.faces.size();
+		size_t collapsed = 0;
+
+		for (auto& c : collapses) {
+			if (face_count <= target_face_count ||
+			    c.error > max_error_sq)
+				break;
+
+			uint32_t p = ids[c.from];
+			uint32_t q = ids[c.to];
+
+			if (locked[p] || locked[q] || !link_condition(topo, p, q) ||
+			    !keeps_orientation(mesh, ids, topo, p, q))
+				continue;
+
+			remap[c.from] = c.to;
+
+			uint32_t from2, to2;
+			if (topo.kinds[p] == Vertex_kind::seam &&
+			    seam_pair(topo, ids, c.from, c.to, from2, to2))
+				remap[from2] = to2;
+
+			add_quadric(quadrics[q], quadrics[p]);
+
+			// The faces around p change, so their vertices must not
+			// move again in this pass.
+			locked[p] = true;
+			for (uint32_t r : topo.neighbours[p])
+				locked[r] = true;
+
+			for (uint32_t f : topo.faces[p]) {
+				auto& face = mesh.faces[f];
+				for (int i = 0; i < 3; ++i) {
+					if (ids[face.vertex_indices[i]] == q) {
+						--face_count;
+						break;
+					}
+				}
+			}
+
+			++collapsed;
+		}
+
+		if (collapsed == 0)
+			break;
+
+		// Move the vertices and drop the faces that collapsed.
+		size_t kept = 0;
+		for (auto& face : mesh.faces) {
+			MDB_file::Face f = face;
+			for (int i = 0; i < 3; ++i)
+				f.vertex_indices[i] =
+				    uint16_t(remap[f.vertex_indices[i]]);
+
+			uint32_t r0 = ids[f.vertex_indices[0]];
+			uint32_t r1 = ids[f.vertex_indices[1]];
+			uint32_t r2 = ids[f.vertex_indices[2]];
+			if (r0 == r1 || r1 == r2 || r2 == r0)
+				continue;
+
+			mesh.faces[kept++] = f;
+		}
+		mesh.faces.resize(kept);
+	}
+
+	remove_unused_vertices(mesh);
+
+	return mesh.faces.size();
+}
+
+size_t decimate_mesh(MDB_file::Rigid_mesh& rm, size_t target_face_count,
+                     float max_error)
+{
+	return decimate(rm, target_face_count, max_error);
+}
+
+size_t decimate_mesh(MDB_file::Skin& skin, size_t target_face_count,
+                     float max_error)
+{
+	return decimate(skin, target_face_count, max_error);
+}
+
+size_t decimate_mesh(MDB_file::Collision_mesh& cm, size_t target_face_count,
+                     float max_error)
+{
+	return decimate(cm, target_face_count, max_error);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "mdb_file.h"
+
+/// Reduces the number of faces of a mesh with quadric error metric edge
+/// collapses (Garland and Heckbert).
+///
+/// Collapses move a vertex onto one of its neighbours (half-edge
+/// collapses), so the remaining vertices keep their exact attributes:
+/// normals, tangents, texture coordinates and skin weights are never
+/// interpolated. To preserve the look of the mesh:
+///
+/// - Vertices at the same position with different attributes (UV or
+///   normal seams) only collapse along the seam, and all their copies
+///   collapse together.
+/// - Vertices on the open border of the mesh only collapse along the
+///   border.
+/// - Collapses that would flip a face or make the mesh non-manifold are
+///   rejected.
+///
+/// Unused vertices are removed at the end and the faces keep their
+/// original winding.
+///
+/// @param target_face_count Decimation stops when the mesh has this many
+/// faces or fewer.
+/// @param max_error Maximum error, in model units, of a collapse: the
+/// area-weighted RMS distance from the new vertex position to the planes
+/// of the original faces merged into it. Decimation stops earlier if the
+/// target can't be reached within this error.
+/// @return Number of faces after decimation.
+size_t decimate_mesh(MDB_file::Rigid_mesh& rm, size_t target_face_count,
+                     float max_error = INFINITY);
+size_t decimate_mesh(MDB_file::Skin& skin, size_t target_face_count,
+                     float max_error = INFINITY);
+size_t decimate_mesh(MDB_file::Collision_mesh& cm, size_t target_face_count,
+                     float max_error = INFINITY);
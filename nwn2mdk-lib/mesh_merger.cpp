@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_merger.h"
+
+namespace {
+
+struct Material_hash {
+	size_t operator()(const MDB_file::Material& m) const
+	{
+		// Map names may have garbage after the null character, so only
+		// the characters before it are hashed.
+		std::hash<std::string_view> h;
+		size_t seed = 0;
+		auto combine = [&](std::string_view s) {
+			seed ^= h(s) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		};
+
+		combine(name(m.diffuse_map_name));
+		combine(name(m.normal_map_name));
+		combine(name(m.tint_map_name));
+		combine(name(m.glow_map_name));
+		combine({(const char*)&m.diffuse_color,
+		         size_t((const char*)(&m.flags + 1) -
+		                (const char*)&m.diffuse_color)});
+
+		return seed;
+	}
+
+	static std::string_view name(const char* s)
+	{
+		return {s, strnlen(s, 32)};
+	}
+};
+
+struct Material_equal {
+	bool operator()(const MDB_file::Material& m1,
+	                const MDB_file::Material& m2) const
+	{
+		return strncmp(m1.diffuse_map_name, m2.diffuse_map_name, 32) ==
+		           0 &&
+		       strncmp(m1.normal_map_name, m2.normal_map_name, 32) == 0 &&
+		       strncmp(m1.tint_map_name, m2.tint_map_name, 32) == 0 &&
+		       strncmp(m1.glow_map_name, m2.glow_map_name, 32) == 0 &&
+		       memcmp(&m1.diffuse_color, &m2.diffuse_color,
+		              (const char*)(&m1.flags + 1) -
+		                  (const char*)&m1.diffuse_color) == 0;
+	}
+};
+
+} // namespace
+
+static void append(MDB_file::Rigid_mesh& dst, const MDB_file::Rigid_mesh& src)
+{
+	auto offset = uint16_t(dst.verts.size());
+
+	dst.verts.insert(dst.verts.end(), src.verts.begin(), src.verts.end());
+
+	dst.faces.reserve(dst.faces.size() + src.faces.size());
+	for (auto face : src.faces) {
+		for (auto& i : face.vertex_indices)
+			i = uint16_t(i + offset);
+		dst.faces.push_back(face);
+	}
+}
+
+size_t merge_rigid_meshes(MDB_file& mdb, size_t max_vertices,
+                          std::vector<uint32_t>* merged_into)
+{
+	max_vertices = std::min<size_t>(max_vertices, 65536);
+
+	// Packets that receive the other packets of each material.
+	std::unordered_map<MDB_file::Material, std::vector<uint32_t>,
+	                   Material_hash, Material_equal>
+	    targets;
+	std::vector<uint32_t> merged;
+	std::vector<uint32_t> receivers;
+
+	for (uint32_t i = 0; i < mdb.packet_count(); ++i) {
+		auto packet = mdb.packet(i);
+		if (!packet || packet->type != MDB_file::RIGD)
+			continue;
+
+		auto& rm = *static_cast<MDB_file::Rigid_mesh*>(packet);
+		auto& group = targets[rm.header.material];
+
+		auto target =
+		    std::find_if(group.begin(), group.end(), [&](uint32_t t) {
+			    auto dst = static_cast<MDB_file::Rigid_mesh*>(
+			        mdb.packet(t));
+			    return dst->verts.size() + rm.verts.size() <=
+			           max_vertices;
+		    });
+
+		if (target == group.end()) {
+			group.push_back(i);
+			continue;
+		}
+
+		append(*static_cast<MDB_file::Rigid_mesh*>(mdb.packet(*target)), rm);
+		merged.push_back(i);
+		receivers.push_back(*target);
+	}
+
+	// Remove from the back, so the indices of the remaining packets
+	// don't change.
+	for (auto i = merged.rbegin(); i != merged.rend(); ++i)
+		mdb.remove_packet(*i);
+
+	if (merged_into) {
+		// A packet only receives packets after it, so its index only
+		// moves by the packets removed before it.
+		std::sort(receivers.begin(), receivers.end());
+		receivers.erase(std::unique(receivers.begin(), receivers.end()),
+		                receivers.end());
+
+		merged_into->clear();
+		for (uint32_t t : receivers) {
+			auto removed_before =
+			    std::lower_bound(merged.begin(), merged.end(), t) -
+			    merged.begin();
+			merged_into->push_back(t - uint32_t(removed_before));
+		}
+	}
+
+	return merged.size();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "mdb_file.h"
+
+/// Merges the RIGD packets of a MDB that have the same material, so the
+/// game draws them with fewer draw calls.
+///
+/// Packets are grouped by a hash of their material (map names, colors,
+/// specular values and flags). The packets of a group are appended to the
+/// first packet of the group that still has room for their vertices, and
+/// removed from the MDB. Merged packets keep the name and the position of
+/// the packet they are appended to, and the names of the appended packets
+/// are lost. Faces are appended in order, so the merged packets should be
+/// optimized again for the vertex cache.
+///
+/// @param mdb The MDB. Its packets are loaded if needed.
+/// @param max_vertices Maximum number of vertices of a merged packet. It
+/// can't be more than 65536, as faces use 16-bit indices.
+/// @param merged_into If not null, receives the indices, after the
+/// removal, of the packets other packets were appended to.
+/// @return Number of packets removed.
+size_t merge_rigid_meshes(MDB_file& mdb, size_t max_vertices = 65536,
+                          std::vector<uint32_t>* merged_into = nullptr);
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "mesh_optimizer.h"
+
+// Parameters of Forsyth's algorithm. The cache modelled while optimizing is
+// a LRU cache bigger than the hardware one, which works well across GPUs.
+const int forsyth_cache_size = 32;
+const float forsyth_cache_decay_power = 1.5f;
+const float forsyth_last_tri_score = 0.75f;
+const float forsyth_valence_boost_scale = 2.0f;
+const float forsyth_valence_boost_power = 0.5f;
+
+static float vertex_score(int cache_position, uint32_t remaining_tris)
+{
+	if (remaining_tris == 0)
+		return -1;
+
+	float score = 0;
+
+	if (cache_position < 0) {
+		// Not in the cache.
+	}
+	else if (cache_position < 3) {
+		// Used by the last triangle. A fixed score, so it doesn't
+		// matter which of its three vertices it is.
+		score = forsyth_last_tri_score;
+	}
+	else {
+		float scaler = 1.0f / (forsyth_cache_size - 3);
+		score = std::pow(1.0f - (cache_position - 3) * scaler,
+		                 forsyth_cache_decay_power);
+	}
+
+	// Favour vertices with few triangles left, so they are finished
+	// instead of leaving lone triangles behind.
+	score += forsyth_valence_boost_scale *
+	         std::pow(float(remaining_tris), -forsyth_valence_boost_power);
+
+	return score;
+}
+
+float acmr(std::span<const MDB_file::Face> faces, size_t vertex_count,
+           unsigned cache_size)
+{
+	if (faces.empty())
+		return 0;
+
+	// Time (in misses) when each vertex entered the FIFO cache.
+	std::vector<size_t> timestamps(vertex_count, 0);
+	size_t misses = 0;
+
+	for (auto& face : faces) {
+		for (int i = 0; i < 3; ++i) {
+			uint16_t v = face.vertex_indices[i];
+			if (v >= vertex_count)
+				continue;
+
+			if (timestamps[v] == 0 ||
+			    misses - timestamps[v] + 1 > cache_size) {
+				++misses;
+				timestamps[v] = misses;
+			}
+		}
+	}
+
+	return float(misses) / faces.size();
+}
+
+void optimize_vertex_cache(std::span<MDB_file::Face> faces,
+                           size_t vertex_count)
+{
+	size_t face_count = faces.size();
+	if (face_count == 0)
+		return;
+
+	// Faces with out of range indices can't be reordered safely.
+	for (auto& face : faces) {
+		for (int i = 0; i < 3; ++i) {
+			if (face.vertex_indices[i] >= vertex_count)
+				return;
+		}
+	}
+
+	// Triangles of each vertex, as offsets into a single array. The
+	// first remaining_tris[v] entries are the triangles not yet emitted.
+	std::vector<uint32_t> remaining_tris(vertex_count, 0);
+	std::vector<uint32_t> first_tri(vertex_count + 1, 0);
+
+	for (auto& face : faces)
+		for (int i = 0; i < 3; ++i)
+			++remaining_tris[face.vertex_indices[i]];
+
+	for (size_t v = 0; v < vertex_count; ++v)
+		first_tri[v + 1] = first_tri[v] + remaining_tris[v];
+
+	std::vector<uint32_t> vertex_tris(first_tri[vertex_count]);
+	std::vector<uint32_t> fill = first_tri;
+
+	for (uint32_t t = 0; t < face_count; ++t)
+		for (int i = 0; i < 3; ++i)
+			vertex_tris[fill[faces[t].vertex_indices[i]]++] = t;
+
+	std::vector<int> cache_position(vertex_count, -1);
+	std::vector<float> scores(vertex_count);
+
+	for (size_t v = 0; v < vertex_count; ++v)
+		scores[v] = vertex_score(-1, remaining_tris[v]);
+
+	std::vector<bool> emitted(face_count, false);
+
+	std::vector<MDB_file::Face> output;
+	output.reserve(face_count);
+
+	// The cache has room for the three vertices of the new triangle
+	// besides the vertices it keeps.
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> new_cache;
+	cache.reserve(forsyth_cache_size + 3);
+	new_cache.reserve(forsyth_cache_size + 3);
+
+	size_t next_unemitted = 0;
+	int64_t best_tri = -1;
+
+	while (output.size() < face_count) {
+		if (best_tri < 0) {
+			// No triangle touches the cache. Continue with the
+			// first one left, which keeps the original locality.
+			while (emitted[next_unemitted])
+				++next_unemitted;
+			best_tri = next_unemitted;
+		}
+
+		auto& face = faces[best_tri];
+		output.push_back(face);
+		emitted[best_tri] = true;
+
+		// Remove the triangle from the lists of its vertices.
+		for (int i = 0; i < 3; ++i) {
+			uint16_t v = face.vertex_indices[i];
+			uint32_t* tris = &vertex_tris[first_tri[v]];
+			uint32_t n = remaining_tris[v];
+
+			for (uint32_t j = 0; j < n; ++j) {
+				if (tris[j] == best_tri) {
+					tris[j] = tris[n - 1];
+					break;
+				}
+			}
+
+			--remaining_tris[v];
+		}
+
+		// Move the triangle vertices to the front of the LRU cache.
+		new_cache.clear();
+		for (int i = 0; i < 3; ++i)
+			new_cache.push_back(face.vertex_indices[i]);
+
+		for (uint32_t v : cache) {
+			if (v != face.vertex_indices[0] &&
+			    v != face.vertex_indices[1] &&
+			    v != face.vertex_indices[2])
+				new_cache.push_back(v);
+		}
+
+		// Vertices pushed out of the cache lose their cache score.
+		for (size_t i = forsyth_cache_size; i < new_cache.size(); ++i) {
+			uint32_t v = new_cache[i];
+			cache_position[v] = -1;
+			scores[v] = vertex_score(-1, remaining_tris[v]);
+		}
+
+		if (new_cache.size() > size_t(forsyth_cache_size))
+			new_cache.resize(forsyth_cache_size);
+
+		cache.swap(new_cache);
+
+		for (size_t i = 0; i < cache.size(); ++i) {
+			uint32_t v = cache[i];
+			cache_position[v] = int(i);
+			scores[v] = vertex_score(int(i), remaining_tris[v]);
+		}
+
+		// Only the triangles of cached vertices changed their score,
+		// so the best one is searched among them.
+		best_tri = -1;
+		float best_score = -1;
+
+		for (uint32_t v : cache) {
+			uint32_t* tris = &vertex_tris[first_tri[v]];
+
+			for (uint32_t j = 0; j < remaining_tris[v]; ++j) {
+				uint32_t t = tris[j];
+				auto& f = faces[t];
+				float score = scores[f.vertex_indices[0]] +
+				              scores[f.vertex_indices[1]] +
+				              scores[f.vertex_indices[2]];
+
+				// Ties are broken by the triangle index so the
+				// result doesn't depend on the list order.
+				if (score > best_score ||
+				    (score == best_score && t < best_tri)) {
+					best_score = score;
+					best_tri = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), faces.begin());
+}
+
+template <typename T>
+static void optimize_mesh_vertex_fetch(T& mesh)
+{
+	size_t vertex_count = mesh.verts.size();
+
+	const uint32_t unused = UINT32_MAX;
+	std::vector<uint32_t> remap(vertex_count, unused);
+	uint32_t next = 0;
+
+	for (auto& face : mesh.faces) {
+		for (int i = 0; i < 3; ++i) {
+			uint16_t& v = face.vertex_indices[i];
+			if (v >= vertex_count)
+				continue;
+
+			if (remap[v] == unused)
+				remap[v] = next++;
+
+			v = uint16_t(remap[v]);
+		}
+	}
+
+	for (auto& r : remap) {
+		if (r == unused)
+			r = next++;
+	}
+
+	auto verts = mesh.verts;
+	for (size_t i = 0; i < vertex_count; ++i)
+		mesh.verts[remap[i]] = verts[i];
+}
+
+void optimize_vertex_fetch(MDB_file::Rigid_mesh& rm)
+{
+	optimize_mesh_vertex_fetch(rm);
+}
+
+void optimize_vertex_fetch(MDB_file::Skin& skin)
+{
+	optimize_mesh_vertex_fetch(skin);
+}
+
+template <typename T>
+static void optimize(T& mesh)
+{
+	optimize_vertex_cache(mesh.faces, mesh.verts.size());
+	optimize_vertex_fetch(mesh);
+}
+
+void optimize_mesh(MDB_file::Rigid_mesh& rm)
+{
+	optimize(rm);
+}
+
+void optimize_mesh(MDB_file::Skin& skin)
+{
+	optimize(skin);
+}
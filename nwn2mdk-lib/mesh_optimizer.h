@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include "mdb_file.h"
+
+/// Returns the average cache miss ratio of a triangle list: the number of
+/// vertices transformed per triangle with a FIFO post-transform cache. It
+/// ranges from 3 (no reuse) down to about 0.5 for a regular grid.
+///
+/// @param faces The triangles.
+/// @param vertex_count Number of vertices referenced by the faces.
+/// @param cache_size Number of entries of the simulated cache.
+float acmr(std::span<const MDB_file::Face> faces, size_t vertex_count,
+           unsigned cache_size = 16);
+
+/// Reorders the faces so consecutive triangles reuse the vertices that are
+/// still in the post-transform vertex cache, using Tom Forsyth's linear
+/// speed vertex cache optimisation. Vertices are not modified.
+void optimize_vertex_cache(std::span<MDB_file::Face> faces,
+                           size_t vertex_count);
+
+/// Reorders the vertices in the order they are first used by the faces,
+/// and updates the faces to the new indices. Unused vertices are moved to
+/// the end.
+void optimize_vertex_fetch(MDB_file::Rigid_mesh& rm);
+void optimize_vertex_fetch(MDB_file::Skin& skin);
+
+/// Reorders the faces for the vertex cache and then the vertices for
+/// fetch locality.
+void optimize_mesh(MDB_file::Rigid_mesh& rm);
+void optimize_mesh(MDB_file::Skin& skin);
@@ -0,0 +1,219 @@
+#include "mesh_streams.h"
+
+// Each attribute is converted with its own loop, so every loop reads one
+// field with a fixed stride and writes contiguous arrays, which compilers
+// vectorize. Converting a whole vertex per iteration would interleave
+// writes to up to 20 arrays.
+
+template <typename Vertex>
+static void split(std::span<const Vertex> verts,
+                  Vector3<float> Vertex::*field,
+                  Mesh_streams::Vector3_stream& stream)
+{
+	float* x = stream.x.data();
+	float* y = stream.y.data();
+	float* z = stream.z.data();
+
+	for (size_t i = 0; i < verts.size(); ++i) {
+		const Vector3<float>& v = verts[i].*field;
+		x[i] = v.x;
+		y[i] = v.y;
+		z[i] = v.z;
+	}
+}
+
+template <typename Vertex>
+static void join(const Mesh_streams::Vector3_stream& stream,
+                 std::span<Vertex> verts, Vector3<float> Vertex::*field)
+{
+	const float* x = stream.x.data();
+	const float* y = stream.y.data();
+	const float* z = stream.z.data();
+
+	for (size_t i = 0; i < verts.size(); ++i) {
+		Vector3<float>& v = verts[i].*field;
+		v.x = x[i];
+		v.y = y[i];
+		v.z = z[i];
+	}
+}
+
+template <typename Vertex>
+static void split_common(std::span<const Vertex> verts, Mesh_streams& streams)
+{
+	split(verts, &Vertex::position, streams.positions);
+	split(verts, &Vertex::normal, streams.normals);
+	split(verts, &Vertex::tangent, streams.tangents);
+	split(verts, &Vertex::binormal, streams.binormals);
+	split(verts, &Vertex::uvw, streams.uvw);
+}
+
+template <typename Vertex>
+static void join_common(const Mesh_streams& streams, std::span<Vertex> verts)
+{
+	join(streams.positions, verts, &Vertex::position);
+	join(streams.normals, verts, &Vertex::normal);
+	join(streams.tangents, verts, &Vertex::tangent);
+	join(streams.binormals, verts, &Vertex::binormal);
+	join(streams.uvw, verts, &Vertex::uvw);
+}
+
+void Mesh_streams::Vector3_stream::resize(size_t n)
+{
+	x.resize(n);
+	y.resize(n);
+	z.resize(n);
+}
+
+void Mesh_streams::resize(size_t n, bool skinned)
+{
+	vertex_count = n;
+	positions.resize(n);
+	normals.resize(n);
+	tangents.resize(n);
+	binormals.resize(n);
+	uvw.resize(n);
+
+	size_t bone_n = skinned ? n : 0;
+	for (int i = 0; i < 4; ++i) {
+		bone_weights[i].resize(bone_n);
+		bone_indices[i].resize(bone_n);
+	}
+	bone_counts.resize(bone_n);
+}
+
+bool Mesh_streams::skinned() const
+{
+	return bone_counts.size() == vertex_count && vertex_count > 0;
+}
+
+static bool has_size(const Mesh_streams::Vector3_stream& stream, size_t n)
+{
+	return stream.x.size() == n && stream.y.size() == n &&
+	       stream.z.size() == n;
+}
+
+bool Mesh_streams::valid() const
+{
+	if (!has_size(positions, vertex_count) ||
+	    !has_size(normals, vertex_count) ||
+	    !has_size(tangents, vertex_count) ||
+	    !has_size(binormals, vertex_count) || !has_size(uvw, vertex_count))
+		return false;
+
+	size_t bone_n = bone_counts.size();
+	if (bone_n != 0 && bone_n != vertex_count)
+		return false;
+
+	for (int i = 0; i < 4; ++i) {
+		if (bone_weights[i].size() != bone_n ||
+		    bone_indices[i].size() != bone_n)
+			return false;
+	}
+
+	return true;
+}
+
+Mesh_streams to_streams(std::span<const MDB_file::Rigid_mesh_vertex> verts)
+{
+	Mesh_streams streams;
+	streams.resize(verts.size(), false);
+	split_common(verts, streams);
+
+	return streams;
+}
+
+Mesh_streams to_streams(std::span<const MDB_file::Skin_vertex> verts)
+{
+	Mesh_streams streams;
+	streams.resize(verts.size(), true);
+	split_common(verts, streams);
+
+	for (int j = 0; j < 4; ++j) {
+		float* weights = streams.bone_weights[j].data();
+		uint8_t* indices = streams.bone_indices[j].data();
+
+		for (size_t i = 0; i < verts.size(); ++i) {
+			weights[i] = verts[i].bone_weights[j];
+			indices[i] = verts[i].bone_indices[j];
+		}
+	}
+
+	float* bone_counts = streams.bone_counts.data();
+	for (size_t i = 0; i < verts.size(); ++i)
+		bone_counts[i] = verts[i].bone_count;
+
+	return streams;
+}
+
+Mesh_streams to_streams(const MDB_file::Rigid_mesh& rm)
+{
+	return to_streams(std::span<const MDB_file::Rigid_mesh_vertex>(
+	    rm.verts.data(), rm.verts.size()));
+}
+
+Mesh_streams to_streams(const MDB_file::Skin& skin)
+{
+	return to_streams(std::span<const MDB_file::Skin_vertex>(
+	    skin.verts.data(), skin.verts.size()));
+}
+
+bool from_streams(const Mesh_streams& streams,
+                  std::span<MDB_file::Rigid_mesh_vertex> verts)
+{
+	if (verts.size() != streams.vertex_count || !streams.valid())
+		return false;
+
+	join_common(streams, verts);
+
+	return true;
+}
+
+bool from_streams(const Mesh_streams& streams,
+                  std::span<MDB_file::Skin_vertex> verts)
+{
+	if (verts.size() != streams.vertex_count || !streams.valid() ||
+	    (verts.size() > 0 && !streams.skinned()))
+		return false;
+
+	join_common(streams, verts);
+
+	for (int j = 0; j < 4; ++j) {
+		const float* weights = streams.bone_weights[j].data();
+		const uint8_t* indices = streams.bone_indices[j].data();
+
+		for (size_t i = 0; i < verts.size(); ++i) {
+			verts[i].bone_weights[j] = weights[i];
+			verts[i].bone_indices[j] = indices[i];
+		}
+	}
+
+	const float* bone_counts = streams.bone_counts.data();
+	for (size_t i = 0; i < verts.size(); ++i)
+		verts[i].bone_count = bone_counts[i];
+
+	return true;
+}
+
+bool from_streams(const Mesh_streams& streams, MDB_file::Rigid_mesh& rm)
+{
+	if (!streams.valid())
+		return false;
+
+	rm.verts.resize(streams.vertex_count);
+
+	return from_streams(streams,
+	                    std::span<MDB_file::Rigid_mesh_vertex>(rm.verts));
+}
+
+bool from_streams(const Mesh_streams& streams, MDB_file::Skin& skin)
+{
+	if (!streams.valid() ||
+	    (streams.vertex_count > 0 && !streams.skinned()))
+		return false;
+
+	skin.verts.resize(streams.vertex_count);
+
+	return from_streams(streams,
+	                    std::span<MDB_file::Skin_vertex>(skin.verts));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <vector>
+
+#include "mdb_file.h"
+
+/// Alignment in bytes of the arrays of Mesh_streams. Enough for AVX loads.
+const size_t mesh_stream_alignment = 32;
+
+/// Allocator that aligns the arrays it allocates to mesh_stream_alignment.
+template <typename T>
+class Aligned_allocator {
+public:
+	using value_type = T;
+
+	Aligned_allocator() = default;
+
+	template <typename U>
+	Aligned_allocator(const Aligned_allocator<U>&)
+	{
+	}
+
+	T* allocate(size_t n)
+	{
+		return (T*)::operator new(
+		    n * sizeof(T), std::align_val_t(mesh_stream_alignment));
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		::operator delete(p, std::align_val_t(mesh_stream_alignment));
+	}
+
+	template <typename U>
+	bool operator==(const Aligned_allocator<U>&) const
+	{
+		return true;
+	}
+};
+
+template <typename T>
+using Aligned_vector = std::vector<T, Aligned_allocator<T>>;
+
+/// Vertex attributes of a mesh stored as a structure of arrays.
+///
+/// Each component of each attribute has its own array, so kernels that
+/// only need e.g. the positions read contiguous floats instead of striding
+/// over the 60 or 84 bytes of MDB_file::Rigid_mesh_vertex and
+/// MDB_file::Skin_vertex. All the arrays have vertex_count elements,
+/// except the bone arrays, which are empty for rigid meshes.
+struct Mesh_streams {
+	struct Vector3_stream {
+		Aligned_vector<float> x, y, z;
+
+		void resize(size_t n);
+	};
+
+	size_t vertex_count = 0;
+	Vector3_stream positions;
+	Vector3_stream normals;
+	Vector3_stream tangents;
+	Vector3_stream binormals;
+	Vector3_stream uvw;
+	std::array<Aligned_vector<float>, 4> bone_weights;
+	std::array<Aligned_vector<uint8_t>, 4> bone_indices;
+	Aligned_vector<float> bone_counts;
+
+	/// Resizes all the arrays.
+	///
+	/// @param n Number of vertices.
+	/// @param skinned If false, the bone arrays are left empty.
+	void resize(size_t n, bool skinned);
+
+	/// Checks if the streams have bone weights and indices.
+	bool skinned() const;
+
+	/// Checks if every array has vertex_count elements, or the bone
+	/// arrays are all empty.
+	bool valid() const;
+};
+
+/// Converts vertices in the packed MDB layout to streams.
+Mesh_streams to_streams(std::span<const MDB_file::Rigid_mesh_vertex> verts);
+Mesh_streams to_streams(std::span<const MDB_file::Skin_vertex> verts);
+
+/// Converts the vertices of a packet to streams.
+Mesh_streams to_streams(const MDB_file::Rigid_mesh& rm);
+Mesh_streams to_streams(const MDB_file::Skin& skin);
+
+/// Writes streams back to vertices in the packed MDB layout.
+///
+/// @param verts Destination. Its size must be streams.vertex_count. For
+/// Skin_vertex, the streams must be skinned.
+/// @return False if the sizes don't match, the streams aren't valid or
+/// bone data is missing.
+bool from_streams(const Mesh_streams& streams,
+                  std::span<MDB_file::Rigid_mesh_vertex> verts);
+bool from_streams(const Mesh_streams& streams,
+                  std::span<MDB_file::Skin_vertex> verts);
+
+/// Replaces the vertices of a packet with the streams. The faces are
+/// kept, so the streams must keep the vertex order.
+bool from_streams(const Mesh_streams& streams, MDB_file::Rigid_mesh& rm);
+bool from_streams(const Mesh_streams& streams, MDB_file::Skin& skin);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// Returns the number of threads to use when thread_count is 0 (one per
+/// hardware thread).
+inline unsigned default_thread_count()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/// Calls f(i) for every i in [begin, end), distributing the indices among
+/// several threads. Indices are handed out one at a time, so it's suited
+/// for work items of different cost. Returns when all calls have finished.
+///
+/// @param thread_count Maximum number of threads. 0 means one per hardware
+/// thread. If it's 1, or there's only one index, f is called in the
+/// calling thread.
+template <typename F>
+void parallel_for(size_t begin, size_t end, F f, unsigned thread_count = 0)
+{
+	if (begin >= end)
+		return;
+
+	if (thread_count == 0)
+		thread_count = default_thread_count();
+
+	thread_count = unsigned(std::min<size_t>(thread_count, end - begin));
+
+	if (thread_count <= 1) {
+		for (size_t i = begin; i < end; ++i)
+			f(i);
+		return;
+	}
+
+	std::atomic<size_t> next = begin;
+	auto worker = [&]() {
+		for (size_t i = next++; i < end; i = next++)
+			f(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count - 1);
+	for (unsigned i = 1; i < thread_count; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& t : threads)
+		t.join();
+}
+
+/// Calls f(range_begin, range_end) for consecutive ranges of at most
+/// block_size indices covering [begin, end), distributing the ranges among
+/// several threads. Useful when the work per index is small and uniform
+/// (e.g. processing vertices).
+template <typename F>
+void parallel_for_blocks(size_t begin, size_t end, size_t block_size, F f,
+                         unsigned thread_count = 0)
+{
+	if (begin >= end)
+		return;
+
+	block_size = std::max<size_t>(block_size, 1);
+	size_t block_count = (end - begin + block_size - 1) / block_size;
+
+	parallel_for(
+	    0, block_count,
+	    [&](size_t block) {
+		    size_t b = begin + block * block_size;
+		    f(b, std::min(b + block_size, end));
+	    },
+	    thread_count);
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "resource_fs.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Returns the uppercase file name of a path.
+static string upper_basename(const string& path)
+{
+	auto pos = path.find_last_of("/\\");
+	string name = pos == string::npos ? path : path.substr(pos + 1);
+	transform(name.begin(), name.end(), name.begin(), [](char c) {
+		return char(::toupper((unsigned char)c));
+	});
+	return name;
+}
+
+void Resource_fs::set_cache_dir(const char* dir)
+{
+	archives_.set_cache_dir(dir);
+}
+
+bool Resource_fs::mount_dir(const char* dir, bool recursive)
+{
+	error_code ec;
+
+	auto add_entry = [&](const fs::directory_entry& entry) {
+		if (!entry.is_regular_file(ec))
+			return;
+
+		auto path = entry.path().string();
+		auto name = upper_basename(path);
+		if (name.empty())
+			return;
+
+		// A directory mounted before keeps its file.
+		if (index.emplace(move(name), unsigned(loose_files.size())).second)
+			loose_files.push_back(move(path));
+	};
+
+	if (recursive) {
+		fs::recursive_directory_iterator it(dir, ec), end;
+		if (ec)
+			return false;
+		for (; it != end; it.increment(ec))
+			add_entry(*it);
+	}
+	else {
+		fs::directory_iterator it(dir, ec), end;
+		if (ec)
+			return false;
+		for (; it != end; it.increment(ec))
+			add_entry(*it);
+	}
+
+	return true;
+}
+
+void Resource_fs::add_file(const char* path)
+{
+	auto name = upper_basename(path);
+	if (name.empty())
+		return;
+
+	index.insert_or_assign(move(name), unsigned(loose_files.size()));
+	loose_files.push_back(path);
+}
+
+bool Resource_fs::mount_archive(const char* filename)
+{
+	return archives_.add_archive(filename);
+}
+
+std::vector<bool>
+Resource_fs::mount_archives(std::span<const std::string> filenames,
+                            unsigned thread_count)
+{
+	return archives_.add_archives(filenames, thread_count);
+}
+
+std::optional<Resource_fs::Location> Resource_fs::find(const char* name) const
+{
+	auto upper = upper_basename(name);
+	if (upper.empty())
+		return {};
+
+	auto it = index.find(upper);
+	if (it != index.end())
+		return Location{LOOSE, 0, it->second};
+
+	auto r = archives_.find_exact(upper.c_str());
+	if (r.matches == 0)
+		return {};
+
+	return Location{ARCHIVE, r.archive_index, r.file_index};
+}
+
+bool Resource_fs::exists(const char* name) const
+{
+	return find(name).has_value();
+}
+
+bool Resource_fs::read(const char* name, std::vector<unsigned char>& data) const
+{
+	auto location = find(name);
+	return location && read(*location, data);
+}
+
+bool Resource_fs::read(const Location& location,
+                       std::vector<unsigned char>& data) const
+{
+	if (location.source == ARCHIVE)
+		return archives_.extract_file_to_mem(location.archive_index,
+		                                     location.file_index, data);
+
+	if (location.file_index >= loose_files.size())
+		return false;
+
+	ifstream in(loose_files[location.file_index], ios::binary);
+	if (!in)
+		return false;
+
+	in.seekg(0, ios::end);
+	auto size = in.tellg();
+	in.seekg(0, ios::beg);
+
+	data.resize(size_t(size));
+	in.read((char*)data.data(), data.size());
+
+	return bool(in);
+}
+
+std::string Resource_fs::path(const Location& location) const
+{
+	if (location.source == ARCHIVE)
+		return archives_.filename(location.archive_index,
+		                          location.file_index);
+
+	if (location.file_index >= loose_files.size())
+		return "";
+
+	return loose_files[location.file_index];
+}
+
+const Archive_container& Resource_fs::archives() const
+{
+	return archives_;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "archive_container.h"
+
+/// Layered file system of loose directories and zip archives.
+///
+/// Loose files override the files of the archives. Among directories, and
+/// among archives, the one mounted first is used when several have a file
+/// with the same name. For the NWN2 data that means mounting the override
+/// directories first, then the newest archives (X2 before X1 before the
+/// base game, v121 before older versions).
+///
+/// Files are looked up by their name without directories, case
+/// insensitively. Loose files are indexed when their directory is
+/// mounted, and archive files are found through the index of the
+/// Archive_container, so lookups don't touch the file system: files added
+/// to a directory after it was mounted aren't seen unless they are
+/// registered with add_file().
+class Resource_fs {
+public:
+	enum Source { LOOSE, ARCHIVE };
+
+	/// Where a file is stored.
+	struct Location {
+		Source source;
+		/// Archive of the file. Unused for loose files.
+		unsigned archive_index;
+		/// Index of the file in the archive, or in the loose files.
+		unsigned file_index;
+	};
+
+	/// Sets the directory where archive indices are cached. See
+	/// Archive_container::set_cache_dir().
+	void set_cache_dir(const char* dir);
+
+	/// Mounts the files of a directory.
+	///
+	/// @param recursive Whether to mount the files in subdirectories too.
+	/// @return Whether the directory could be read.
+	bool mount_dir(const char* dir, bool recursive = false);
+
+	/// Adds a loose file written after the directories were mounted. It
+	/// takes priority over the files already indexed with the same name.
+	void add_file(const char* path);
+
+	/// Mounts the files of a zip archive.
+	bool mount_archive(const char* filename);
+
+	/// Mounts several archives, reading their indices concurrently. They
+	/// get the priority of the order of the list, as if mounted one by
+	/// one.
+	///
+	/// @return Whether each archive could be opened.
+	std::vector<bool> mount_archives(std::span<const std::string> filenames,
+	                                 unsigned thread_count = 0);
+
+	/// Finds a file by its name, without directories.
+	///
+	/// @return The location of the file in the layer with the highest
+	/// priority, or nothing if no layer has it.
+	std::optional<Location> find(const char* name) const;
+
+	bool exists(const char* name) const;
+
+	/// Reads the contents of a file.
+	bool read(const char* name, std::vector<unsigned char>& data) const;
+	bool read(const Location& location,
+	          std::vector<unsigned char>& data) const;
+
+	/// Returns the path of a loose file, or the path of a file inside its
+	/// archive.
+	std::string path(const Location& location) const;
+
+	/// Returns the mounted archives, for substring searches.
+	const Archive_container& archives() const;
+
+private:
+	Archive_container archives_;
+	std::vector<std::string> loose_files;
+	/// Uppercase file name to index in loose_files.
+	std::unordered_map<std::string, unsigned> index;
+};
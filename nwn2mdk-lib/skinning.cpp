@@ -0,0 +1,363 @@
+#include <assert.h>
+#include <cmath>
+#include <string.h>
+
+#include "parallel_for.h"
+#include "skinning.h"
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SKINNING_SSE
+#endif
+
+// Number of vertices skinned by a thread at a time.
+const size_t skinning_block_size = 4096;
+
+// 4x4 matrix in column major order (m[column][row]).
+struct Matrix4 {
+	float m[4][4];
+};
+
+static Matrix4 identity_matrix()
+{
+	Matrix4 r = {};
+	for (int i = 0; i < 4; ++i)
+		r.m[i][i] = 1;
+
+	return r;
+}
+
+static Matrix4 operator*(const Matrix4& a, const Matrix4& b)
+{
+	Matrix4 r;
+	for (int c = 0; c < 4; ++c) {
+		for (int row = 0; row < 4; ++row) {
+			r.m[c][row] = a.m[0][row] * b.m[c][0] +
+			              a.m[1][row] * b.m[c][1] +
+			              a.m[2][row] * b.m[c][2] +
+			              a.m[3][row] * b.m[c][3];
+		}
+	}
+
+	return r;
+}
+
+// Returns translation * rotation * scale_shear.
+static Matrix4 transform_matrix(const GR2_transform& t)
+{
+	float rot[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+	if (t.flags & GR2_has_rotation) {
+		float x = t.rotation.x, y = t.rotation.y, z = t.rotation.z,
+		      w = t.rotation.w;
+
+		// rot[column][row]
+		rot[0][0] = 1 - 2 * (y * y + z * z);
+		rot[0][1] = 2 * (x * y + z * w);
+		rot[0][2] = 2 * (x * z - y * w);
+		rot[1][0] = 2 * (x * y - z * w);
+		rot[1][1] = 1 - 2 * (x * x + z * z);
+		rot[1][2] = 2 * (y * z + x * w);
+		rot[2][0] = 2 * (x * z + y * w);
+		rot[2][1] = 2 * (y * z - x * w);
+		rot[2][2] = 1 - 2 * (x * x + y * y);
+	}
+
+	float ss[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+	if (t.flags & GR2_has_scale_shear)
+		memcpy(ss, t.scale_shear, sizeof(ss));
+
+	Matrix4 r = identity_matrix();
+
+	for (int c = 0; c < 3; ++c) {
+		for (int row = 0; row < 3; ++row) {
+			r.m[c][row] = rot[0][row] * ss[c][0] +
+			              rot[1][row] * ss[c][1] +
+			              rot[2][row] * ss[c][2];
+		}
+	}
+
+	if (t.flags & GR2_has_position) {
+		r.m[3][0] = t.translation.x;
+		r.m[3][1] = t.translation.y;
+		r.m[3][2] = t.translation.z;
+	}
+
+	return r;
+}
+
+static void compute_world_matrix(GR2_skeleton& skel,
+                                 std::span<const GR2_transform> pose,
+                                 int32_t bone_index,
+                                 std::vector<Matrix4>& world,
+                                 std::vector<bool>& computed)
+{
+	if (computed[bone_index])
+		return;
+
+	// Marked before recursing, so a malformed skeleton with a cycle
+	// doesn't recurse forever.
+	computed[bone_index] = true;
+
+	GR2_bone& bone = skel.bones[bone_index];
+	Matrix4 local = transform_matrix(pose.empty() ? bone.transform
+	                                              : pose[bone_index]);
+
+	int32_t parent = bone.parent_index;
+	if (parent >= 0 && parent < skel.bones_count) {
+		compute_world_matrix(skel, pose, parent, world, computed);
+		world[bone_index] = world[parent] * local;
+	}
+	else
+		world[bone_index] = local;
+}
+
+std::vector<uint32_t> skin_bone_map(GR2_skeleton& skel, bool face_bones)
+{
+	std::vector<uint32_t> body;
+	std::vector<uint32_t> face;
+	int32_t ribcage = -1;
+
+	for (int32_t i = 0; i < skel.bones_count; ++i) {
+		const char* name = skel.bones[i].name;
+
+		if (strncmp(name, "ap_", 3) == 0) {
+			// Attachment points are not used for skinning.
+		}
+		else if (strncmp(name, "f_", 2) == 0)
+			face.push_back(i);
+		else if (strcmp(name, "Ribcage") == 0)
+			ribcage = i;
+		else
+			body.push_back(i);
+	}
+
+	if (ribcage >= 0)
+		body.push_back(ribcage);
+
+	if (!face_bones)
+		return body;
+
+	// Cutscene heads use the face bones first, and the body bones for
+	// the remaining indices.
+	for (size_t i = face.size(); i < body.size(); ++i)
+		face.push_back(body[i]);
+
+	return face;
+}
+
+std::vector<Skinning_matrix>
+skinning_palette(GR2_skeleton& skel, std::span<const GR2_transform> pose,
+                 std::span<const uint32_t> bone_map)
+{
+	std::vector<Matrix4> world(skel.bones_count);
+	std::vector<bool> computed(skel.bones_count, false);
+
+	if (!pose.empty() && pose.size() < size_t(skel.bones_count))
+		pose = {};
+
+	std::vector<Skinning_matrix> palette(bone_map.size());
+
+	for (size_t i = 0; i < bone_map.size(); ++i) {
+		Matrix4 m = identity_matrix();
+
+		uint32_t bone_index = bone_map[i];
+		if (bone_index < uint32_t(skel.bones_count)) {
+			compute_world_matrix(skel, pose, bone_index, world,
+			                     computed);
+
+			Matrix4 inverse_world;
+			memcpy(inverse_world.m,
+			       skel.bones[bone_index].inverse_world_transform,
+			       sizeof(inverse_world.m));
+
+			m = world[bone_index] * inverse_world;
+		}
+
+		for (int c = 0; c < 4; ++c) {
+			for (int row = 0; row < 3; ++row)
+				palette[i].columns[c][row] = m.m[c][row];
+			palette[i].columns[c][3] = 0;
+		}
+	}
+
+	return palette;
+}
+
+#ifdef SKINNING_SSE
+
+static void skin_range(const Mesh_streams& streams,
+                       std::span<const Skinning_matrix> palette,
+                       Mesh_streams::Vector3_stream& positions,
+                       Mesh_streams::Vector3_stream& normals, size_t begin,
+                       size_t end)
+{
+	alignas(16) float p[4];
+	alignas(16) float n[4];
+
+	for (size_t i = begin; i < end; ++i) {
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_setzero_ps();
+		__m128 c2 = _mm_setzero_ps();
+		__m128 c3 = _mm_setzero_ps();
+		float weight_sum = 0;
+
+		for (int j = 0; j < 4; ++j) {
+			float w = streams.bone_weights[j][i];
+			uint8_t bone_index = streams.bone_indices[j][i];
+			if (w == 0 || bone_index >= palette.size())
+				continue;
+
+			const Skinning_matrix& m = palette[bone_index];
+			__m128 ws = _mm_set1_ps(w);
+			c0 = _mm_add_ps(c0, _mm_mul_ps(ws, _mm_load_ps(m.columns[0])));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(ws, _mm_load_ps(m.columns[1])));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(ws, _mm_load_ps(m.columns[2])));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(ws, _mm_load_ps(m.columns[3])));
+			weight_sum += w;
+		}
+
+		float px = streams.positions.x[i];
+		float py = streams.positions.y[i];
+		float pz = streams.positions.z[i];
+		float nx = streams.normals.x[i];
+		float ny = streams.normals.y[i];
+		float nz = streams.normals.z[i];
+
+		if (weight_sum == 0) {
+			// Unweighted vertices stay in the bind pose.
+			positions.x[i] = px;
+			positions.y[i] = py;
+			positions.z[i] = pz;
+			normals.x[i] = nx;
+			normals.y[i] = ny;
+			normals.z[i] = nz;
+			continue;
+		}
+
+		__m128 vp = _mm_add_ps(
+		    _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(px)),
+		               _mm_mul_ps(c1, _mm_set1_ps(py))),
+		    _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(pz)), c3));
+		__m128 vn = _mm_add_ps(
+		    _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(nx)),
+		               _mm_mul_ps(c1, _mm_set1_ps(ny))),
+		    _mm_mul_ps(c2, _mm_set1_ps(nz)));
+
+		_mm_store_ps(p, vp);
+		_mm_store_ps(n, vn);
+
+		positions.x[i] = p[0];
+		positions.y[i] = p[1];
+		positions.z[i] = p[2];
+
+		float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float inv_len = len > 0 ? 1 / len : 0;
+		normals.x[i] = n[0] * inv_len;
+		normals.y[i] = n[1] * inv_len;
+		normals.z[i] = n[2] * inv_len;
+	}
+}
+
+#else
+
+static void skin_range(const Mesh_streams& streams,
+                       std::span<const Skinning_matrix> palette,
+                       Mesh_streams::Vector3_stream& positions,
+                       Mesh_streams::Vector3_stream& normals, size_t begin,
+                       size_t end)
+{
+	for (size_t i = begin; i < end; ++i) {
+		float c[4][3] = {};
+		float weight_sum = 0;
+
+		for (int j = 0; j < 4; ++j) {
+			float w = streams.bone_weights[j][i];
+			uint8_t bone_index = streams.bone_indices[j][i];
+			if (w == 0 || bone_index >= palette.size())
+				continue;
+
+			const Skinning_matrix& m = palette[bone_index];
+			for (int col = 0; col < 4; ++col)
+				for (int row = 0; row < 3; ++row)
+					c[col][row] += w * m.columns[col][row];
+			weight_sum += w;
+		}
+
+		float px = streams.positions.x[i];
+		float py = streams.positions.y[i];
+		float pz = streams.positions.z[i];
+		float nx = streams.normals.x[i];
+		float ny = streams.normals.y[i];
+		float nz = streams.normals.z[i];
+
+		if (weight_sum == 0) {
+			// Unweighted vertices stay in the bind pose.
+			positions.x[i] = px;
+			positions.y[i] = py;
+			positions.z[i] = pz;
+			normals.x[i] = nx;
+			normals.y[i] = ny;
+			normals.z[i] = nz;
+			continue;
+		}
+
+		float p[3], n[3];
+		for (int row = 0; row < 3; ++row) {
+			p[row] = c[0][row] * px + c[1][row] * py + c[2][row] * pz +
+			         c[3][row];
+			n[row] = c[0][row] * nx + c[1][row] * ny + c[2][row] * nz;
+		}
+
+		positions.x[i] = p[0];
+		positions.y[i] = p[1];
+		positions.z[i] = p[2];
+
+		float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float inv_len = len > 0 ? 1 / len : 0;
+		normals.x[i] = n[0] * inv_len;
+		normals.y[i] = n[1] * inv_len;
+		normals.z[i] = n[2] * inv_len;
+	}
+}
+
+#endif
+
+void skin_vertices(const Mesh_streams& streams,
+                   std::span<const Skinning_matrix> palette,
+                   Mesh_streams::Vector3_stream& positions,
+                   Mesh_streams::Vector3_stream& normals,
+                   unsigned thread_count)
+{
+	// The kernels index every array up to vertex_count.
+	assert(streams.valid());
+
+	positions.resize(streams.vertex_count);
+	normals.resize(streams.vertex_count);
+
+	if (!streams.skinned()) {
+		positions = streams.positions;
+		normals = streams.normals;
+		return;
+	}
+
+	parallel_for_blocks(
+	    0, streams.vertex_count, skinning_block_size,
+	    [&](size_t begin, size_t end) {
+		    skin_range(streams, palette, positions, normals, begin,
+		               end);
+	    },
+	    thread_count);
+}
+
+void skin_vertices(const MDB_file::Skin& skin,
+                   std::span<const Skinning_matrix> palette,
+                   Mesh_streams::Vector3_stream& positions,
+                   Mesh_streams::Vector3_stream& normals,
+                   unsigned thread_count)
+{
+	skin_vertices(to_streams(skin), palette, positions, normals,
+	              thread_count);
+}
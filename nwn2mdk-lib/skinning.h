@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "gr2.h"
+#include "mdb_file.h"
+#include "mesh_streams.h"
+
+/// Affine transform used for skinning. Stored as the four columns of a
+/// 4x4 matrix that transforms column vectors; the last row is implicitly
+/// (0, 0, 0, 1) and the fourth element of each column is padding.
+struct alignas(16) Skinning_matrix {
+	float columns[4][4];
+};
+
+/// Returns the skeleton bones that the bone indices of the vertices of a
+/// SKIN packet refer to, in the same order as nw2fbx binds them:
+/// attachment points ("ap_...") are skipped, face bones ("f_...") are only
+/// used by cutscene heads, and "Ribcage" always goes last.
+///
+/// @param skel The skeleton of the skin.
+/// @param face_bones If true, returns the face bones (for skins with the
+/// MDB_file::CUTSCENE_MESH flag). Otherwise, returns the body bones.
+/// @return Index of a skeleton bone for each skin bone index.
+std::vector<uint32_t> skin_bone_map(GR2_skeleton& skel, bool face_bones);
+
+/// Computes the skinning matrices of a pose. Each matrix transforms a
+/// vertex from the bind pose to the posed bone.
+///
+/// @param skel The skeleton.
+/// @param pose Local transform of each skeleton bone. If empty, the rest
+/// pose of the skeleton is used.
+/// @param bone_map Skeleton bone of each skin bone index (see
+/// skin_bone_map).
+/// @return A matrix for each element of bone_map.
+std::vector<Skinning_matrix>
+skinning_palette(GR2_skeleton& skel, std::span<const GR2_transform> pose,
+                 std::span<const uint32_t> bone_map);
+
+/// Applies linear blend skinning to the vertices of a skin.
+///
+/// Positions and normals are transformed by the sum of the palette
+/// matrices of their bones, weighted by the bone weights. Bone indices
+/// outside the palette are ignored. Normals are renormalized.
+///
+/// @param streams Skinned vertex streams (see to_streams). They must be
+/// valid (see Mesh_streams::valid).
+/// @param palette Skinning matrices (see skinning_palette).
+/// @param positions Resized to the vertex count and filled with the
+/// skinned positions.
+/// @param normals Resized to the vertex count and filled with the skinned
+/// normals.
+/// @param thread_count Maximum number of threads. 0 means one per hardware
+/// thread.
+void skin_vertices(const Mesh_streams& streams,
+                   std::span<const Skinning_matrix> palette,
+                   Mesh_streams::Vector3_stream& positions,
+                   Mesh_streams::Vector3_stream& normals,
+                   unsigned thread_count = 0);
+
+/// Applies linear blend skinning to the vertices of a SKIN packet.
+void skin_vertices(const MDB_file::Skin& skin,
+                   std::span<const Skinning_matrix> palette,
+                   Mesh_streams::Vector3_stream& positions,
+                   Mesh_streams::Vector3_stream& normals,
+                   unsigned thread_count = 0);
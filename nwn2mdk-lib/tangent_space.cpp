@@ -0,0 +1,252 @@
+#include <cmath>
+#include <cstdint>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "parallel_for.h"
+#include "tangent_space.h"
+
+// Number of triangles or groups processed by a thread at a time.
+const size_t tangent_block_size = 1024;
+
+// Vertices that share these attributes and texture orientation share a
+// tangent frame.
+struct Tangent_key {
+	Vector3<float> position;
+	Vector3<float> normal;
+	float u, v;
+	uint32_t orientation_preserving;
+};
+
+struct Tangent_key_hash {
+	size_t operator()(const Tangent_key& k) const
+	{
+		return std::hash<std::string_view>()(
+		    std::string_view((const char*)&k, sizeof(k)));
+	}
+};
+
+struct Tangent_key_equal {
+	bool operator()(const Tangent_key& k1, const Tangent_key& k2) const
+	{
+		return memcmp(&k1, &k2, sizeof(k1)) == 0;
+	}
+};
+
+// Contribution of a face corner to the tangent of its vertex.
+struct Corner {
+	Vector3<float> tangent;
+	bool orientation_preserving;
+};
+
+// Component of v perpendicular to the unit vector n.
+static Vector3<float> project(const Vector3<float>& v, const Vector3<float>& n)
+{
+	return v - dot(n, v) * n;
+}
+
+// Any unit vector perpendicular to n.
+static Vector3<float> perpendicular(const Vector3<float>& n)
+{
+	Vector3<float> axis = std::fabs(n.x) < 0.9f ? Vector3<float>(1, 0, 0)
+	                                            : Vector3<float>(0, 1, 0);
+	return normalize(project(axis, n));
+}
+
+template <typename Vertex>
+static void compute_corners(const std::vector<Vertex>& verts,
+                            const MDB_file::Face& face, Corner* corners)
+{
+	const Vertex* v[3];
+	for (int i = 0; i < 3; ++i)
+		v[i] = &verts[face.vertex_indices[i]];
+
+	Vector3<float> d1 = v[1]->position - v[0]->position;
+	Vector3<float> d2 = v[2]->position - v[0]->position;
+	float du1 = v[1]->uvw.x - v[0]->uvw.x;
+	float dv1 = v[1]->uvw.y - v[0]->uvw.y;
+	float du2 = v[2]->uvw.x - v[0]->uvw.x;
+	float dv2 = v[2]->uvw.y - v[0]->uvw.y;
+
+	// Twice the signed area in texture space. Its sign tells if the
+	// texture is mirrored.
+	float signed_area = du1 * dv2 - dv1 * du2;
+	bool orientation_preserving = signed_area > 0;
+
+	Vector3<float> tangent;
+	if (signed_area != 0) {
+		float s = orientation_preserving ? 1.0f : -1.0f;
+		tangent = s * normalize(dv2 * d1 - dv1 * d2);
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		const Vector3<float>& n = v[i]->normal;
+		Vector3<float> e1 =
+		    normalize(project(v[(i + 1) % 3]->position - v[i]->position, n));
+		Vector3<float> e2 =
+		    normalize(project(v[(i + 2) % 3]->position - v[i]->position, n));
+
+		float c = std::fmax(-1.0f, std::fmin(1.0f, dot(e1, e2)));
+		float angle = std::acos(c);
+
+		corners[i].tangent = angle * normalize(project(tangent, n));
+		corners[i].orientation_preserving = orientation_preserving;
+	}
+}
+
+template <typename T>
+static bool generate_mesh_tangents(T& mesh, unsigned thread_count)
+{
+	size_t vertex_count = mesh.verts.size();
+	size_t face_count = mesh.faces.size();
+
+	for (auto& face : mesh.faces) {
+		for (int i = 0; i < 3; ++i) {
+			if (face.vertex_indices[i] >= vertex_count)
+				return false;
+		}
+	}
+
+	// Each triangle only writes its own corners.
+	std::vector<Corner> corners(face_count * 3);
+
+	parallel_for_blocks(
+	    0, face_count, tangent_block_size,
+	    [&](size_t begin, size_t end) {
+		    for (size_t f = begin; f < end; ++f)
+			    compute_corners(mesh.verts, mesh.faces[f],
+			                    &corners[f * 3]);
+	    },
+	    thread_count);
+
+	// Groups are numbered in corner order, so they don't depend on
+	// hashing or scheduling.
+	std::unordered_map<Tangent_key, uint32_t, Tangent_key_hash,
+	                   Tangent_key_equal>
+	    group_map;
+	group_map.reserve(vertex_count);
+	std::vector<uint32_t> corner_groups(corners.size());
+
+	for (size_t c = 0; c < corners.size(); ++c) {
+		auto& v = mesh.verts[mesh.faces[c / 3].vertex_indices[c % 3]];
+
+		Tangent_key key;
+		key.position = v.position;
+		key.normal = v.normal;
+		key.u = v.uvw.x;
+		key.v = v.uvw.y;
+		key.orientation_preserving = corners[c].orientation_preserving;
+
+		auto it = group_map.try_emplace(key, uint32_t(group_map.size()));
+		corner_groups[c] = it.first->second;
+	}
+
+	size_t group_count = group_map.size();
+
+	// Corners of each group in ascending order.
+	std::vector<uint32_t> group_offsets(group_count + 1, 0);
+	for (uint32_t g : corner_groups)
+		++group_offsets[g + 1];
+	for (size_t g = 0; g < group_count; ++g)
+		group_offsets[g + 1] += group_offsets[g];
+
+	std::vector<uint32_t> group_corners(corners.size());
+	std::vector<uint32_t> fill(group_offsets.begin(),
+	                           group_offsets.end() - 1);
+	for (size_t c = 0; c < corners.size(); ++c)
+		group_corners[fill[corner_groups[c]]++] = uint32_t(c);
+
+	std::vector<Vector3<float>> tangents(group_count);
+	std::vector<Vector3<float>> binormals(group_count);
+
+	parallel_for_blocks(
+	    0, group_count, tangent_block_size,
+	    [&](size_t begin, size_t end) {
+		    for (size_t g = begin; g < end; ++g) {
+			    uint32_t first = group_corners[group_offsets[g]];
+			    auto& v = mesh.verts[mesh.faces[first / 3]
+			                             .vertex_indices[first % 3]];
+
+			    Vector3<float> sum;
+			    for (uint32_t i = group_offsets[g];
+			         i < group_offsets[g + 1]; ++i)
+				    sum = sum + corners[group_corners[i]].tangent;
+
+			    Vector3<float> t = normalize(sum);
+			    if (length(t) == 0)
+				    t = perpendicular(v.normal);
+
+			    float sign = corners[first].orientation_preserving
+			                     ? 1.0f
+			                     : -1.0f;
+
+			    tangents[g] = t;
+			    binormals[g] = sign * cross(v.normal, t);
+		    }
+	    },
+	    thread_count);
+
+	// A vertex whose corners fall in different groups (a mirrored seam)
+	// is duplicated, one copy per group.
+	const uint32_t no_group = UINT32_MAX;
+	std::vector<uint32_t> vertex_groups(vertex_count, no_group);
+	std::unordered_map<uint64_t, uint32_t> split_vertices;
+	std::vector<uint32_t> new_vertex_sources;
+	std::vector<uint16_t> corner_vertices(corners.size());
+
+	for (size_t c = 0; c < corners.size(); ++c) {
+		uint32_t v = mesh.faces[c / 3].vertex_indices[c % 3];
+		uint32_t g = corner_groups[c];
+
+		if (vertex_groups[v] == no_group)
+			vertex_groups[v] = g;
+
+		if (vertex_groups[v] != g) {
+			uint64_t key = (uint64_t(v) << 32) | g;
+			auto it = split_vertices.try_emplace(
+			    key, uint32_t(vertex_count + new_vertex_sources.size()));
+			if (it.second)
+				new_vertex_sources.push_back(v);
+			v = it.first->second;
+		}
+
+		if (v > UINT16_MAX)
+			return false;
+
+		corner_vertices[c] = uint16_t(v);
+	}
+
+	for (size_t i = 0; i < new_vertex_sources.size(); ++i) {
+		mesh.verts.push_back(mesh.verts[new_vertex_sources[i]]);
+		vertex_groups.push_back(no_group);
+	}
+
+	for (size_t c = 0; c < corners.size(); ++c) {
+		uint16_t v = corner_vertices[c];
+		mesh.faces[c / 3].vertex_indices[c % 3] = v;
+		vertex_groups[v] = corner_groups[c];
+	}
+
+	for (size_t v = 0; v < mesh.verts.size(); ++v) {
+		uint32_t g = vertex_groups[v];
+		if (g == no_group)
+			continue;
+
+		mesh.verts[v].tangent = tangents[g];
+		mesh.verts[v].binormal = binormals[g];
+	}
+
+	return true;
+}
+
+bool generate_tangents(MDB_file::Rigid_mesh& rm, unsigned thread_count)
+{
+	return generate_mesh_tangents(rm, thread_count);
+}
+
+bool generate_tangents(MDB_file::Skin& skin, unsigned thread_count)
+{
+	return generate_mesh_tangents(skin, thread_count);
+}
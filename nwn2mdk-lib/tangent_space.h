@@ -0,0 +1,29 @@
+#pragma once
+
+#include "mdb_file.h"
+
+/// Generates the tangents and binormals of a mesh from its positions,
+/// normals and texture coordinates, following the MikkTSpace conventions:
+///
+/// - Triangle tangents are projected on the plane of the vertex normal and
+///   weighted by the corner angle.
+/// - Corners are grouped by position, normal, texture coordinates and
+///   texture orientation, so vertices split only by other attributes get
+///   the same tangent frame.
+/// - Corners of a vertex with mirrored texture orientation get their own
+///   copy of the vertex, so a mirrored UV seam doesn't average opposite
+///   tangents.
+/// - The binormal is the cross product of normal and tangent, flipped
+///   for mirrored texture coordinates.
+///
+/// Triangles and groups are processed in parallel, but sums are always
+/// accumulated in the same order, so the result is bit-identical between
+/// runs and for any thread count.
+///
+/// @param thread_count Maximum number of threads. 0 means one per hardware
+/// thread.
+/// @return False if the mesh has faces with out of range indices, or if
+/// splitting vertices would exceed the 65536 vertex limit. The mesh isn't
+/// modified in that case.
+bool generate_tangents(MDB_file::Rigid_mesh& rm, unsigned thread_count = 0);
+bool generate_tangents(MDB_file::Skin& skin, unsigned thread_count = 0);
@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "walk_mesh_graph.h"
+
+namespace {
+
+struct Position_hash {
+	size_t operator()(const Vector3<float>& p) const
+	{
+		return std::hash<std::string_view>()(
+		    std::string_view((const char*)&p, sizeof(p)));
+	}
+};
+
+struct Position_equal {
+	bool operator()(const Vector3<float>& p1, const Vector3<float>& p2) const
+	{
+		return memcmp(&p1, &p2, sizeof(p1)) == 0;
+	}
+};
+
+struct Point2 {
+	float x, y;
+};
+
+} // namespace
+
+static bool is_walkable(const MDB_file::Walk_mesh_face& face)
+{
+	return face.flags[0] & 0x01;
+}
+
+// Returns, for each vertex, the index of the first vertex at the same
+// position.
+static std::vector<uint32_t> position_ids(const MDB_file::Walk_mesh& wm)
+{
+	std::unordered_map<Vector3<float>, uint32_t, Position_hash,
+	                   Position_equal>
+	    first;
+	first.reserve(wm.verts.size());
+
+	std::vector<uint32_t> ids(wm.verts.size());
+	for (uint32_t i = 0; i < wm.verts.size(); ++i)
+		ids[i] = first.try_emplace(wm.verts[i].position, i).first->second;
+
+	return ids;
+}
+
+static bool valid_face(const MDB_file::Walk_mesh& wm,
+                       const MDB_file::Walk_mesh_face& face)
+{
+	return face.vertex_indices[0] < wm.verts.size() &&
+	       face.vertex_indices[1] < wm.verts.size() &&
+	       face.vertex_indices[2] < wm.verts.size();
+}
+
+static uint64_t half_edge_key(uint32_t a, uint32_t b)
+{
+	return (uint64_t(a) << 32) | b;
+}
+
+// Maps each half-edge (a, b) of the valid faces to face * 3 + edge.
+static std::unordered_map<uint64_t, uint32_t>
+half_edges(const MDB_file::Walk_mesh& wm, const std::vector<uint32_t>& ids)
+{
+	std::unordered_map<uint64_t, uint32_t> edges;
+	edges.reserve(wm.faces.size() * 3);
+
+	for (uint32_t f = 0; f < wm.faces.size(); ++f) {
+		auto& face = wm.faces[f];
+		if (!valid_face(wm, face))
+			continue;
+
+		for (uint32_t e = 0; e < 3; ++e) {
+			uint32_t a = ids[face.vertex_indices[e]];
+			uint32_t b = ids[face.vertex_indices[(e + 1) % 3]];
+			edges.try_emplace(half_edge_key(a, b), f * 3 + e);
+		}
+	}
+
+	return edges;
+}
+
+static std::vector<std::array<uint32_t, 3>>
+face_adjacency(const MDB_file::Walk_mesh& wm, const std::vector<uint32_t>& ids)
+{
+	auto edges = half_edges(wm, ids);
+
+	std::vector<std::array<uint32_t, 3>> adjacency(
+	    wm.faces.size(),
+	    {Walk_mesh_graph::no_face, Walk_mesh_graph::no_face,
+	     Walk_mesh_graph::no_face});
+
+	for (uint32_t f = 0; f < wm.faces.size(); ++f) {
+		auto& face = wm.faces[f];
+		if (!valid_face(wm, face))
+			continue;
+
+		for (uint32_t e = 0; e < 3; ++e) {
+			uint32_t a = ids[face.vertex_indices[e]];
+			uint32_t b = ids[face.vertex_indices[(e + 1) % 3]];
+
+			// The neighbour has the same edge in opposite direction.
+			auto it = edges.find(half_edge_key(b, a));
+			if (it != edges.end() && it->second / 3 != f)
+				adjacency[f][e] = it->second / 3;
+		}
+	}
+
+	return adjacency;
+}
+
+Walk_mesh_graph::Walk_mesh_graph(const MDB_file::Walk_mesh& walk_mesh)
+{
+	auto ids = position_ids(walk_mesh);
+	adjacency = face_adjacency(walk_mesh, ids);
+
+	centers.resize(walk_mesh.faces.size());
+	for (size_t f = 0; f < walk_mesh.faces.size(); ++f) {
+		auto& face = walk_mesh.faces[f];
+		if (!valid_face(walk_mesh, face))
+			continue;
+
+		centers[f] = (1.0f / 3) *
+		             (walk_mesh.verts[face.vertex_indices[0]].position +
+		              walk_mesh.verts[face.vertex_indices[1]].position +
+		              walk_mesh.verts[face.vertex_indices[2]].position);
+	}
+
+	link_offsets.reserve(walk_mesh.faces.size() + 1);
+	link_offsets.push_back(0);
+
+	for (size_t f = 0; f < walk_mesh.faces.size(); ++f) {
+		if (is_walkable(walk_mesh.faces[f])) {
+			for (uint32_t n : adjacency[f]) {
+				if (n == no_face || !is_walkable(walk_mesh.faces[n]))
+					continue;
+
+				link_list.push_back(
+				    {n, length(centers[n] - centers[f])});
+			}
+		}
+
+		link_offsets.push_back(uint32_t(link_list.size()));
+	}
+}
+
+const std::array<uint32_t, 3>& Walk_mesh_graph::neighbours(uint32_t face) const
+{
+	return adjacency[face];
+}
+
+std::span<const Walk_mesh_graph::Link>
+Walk_mesh_graph::links(uint32_t face) const
+{
+	return {link_list.data() + link_offsets[face],
+	        link_list.data() + link_offsets[face + 1]};
+}
+
+const Vector3<float>& Walk_mesh_graph::center(uint32_t face) const
+{
+	return centers[face];
+}
+
+size_t Walk_mesh_graph::face_count() const
+{
+	return adjacency.size();
+}
+
+static float cross2(const Point2& o, const Point2& a, const Point2& b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+static bool in_triangle(const Point2& p, const Point2& a, const Point2& b,
+                        const Point2& c, float sign)
+{
+	return cross2(a, b, p) * sign >= 0 && cross2(b, c, p) * sign >= 0 &&
+	       cross2(c, a, p) * sign >= 0;
+}
+
+// Triangulates a simple polygon by ear clipping.
+//
+// @return False if no ear was found (e.g. self-intersecting border).
+static bool triangulate(const std::vector<Point2>& points,
+                        std::vector<std::array<uint32_t, 3>>& triangles)
+{
+	size_t n = points.size();
+
+	float area = 0;
+	for (size_t i = 0; i < n; ++i) {
+		auto& a = points[i];
+		auto& b = points[(i + 1) % n];
+		area += a.x * b.y - b.x * a.y;
+	}
+
+	if (area == 0)
+		return false;
+
+	float sign = area > 0 ? 1.0f : -1.0f;
+
+	std::vector<uint32_t> remaining(n);
+	for (uint32_t i = 0; i < n; ++i)
+		remaining[i] = i;
+
+	while (remaining.size() > 3) {
+		size_t m = remaining.size();
+		bool clipped = false;
+
+		for (size_t i = 0; i < m; ++i) {
+			uint32_t prev = remaining[(i + m - 1) % m];
+			uint32_t cur = remaining[i];
+			uint32_t next = remaining[(i + 1) % m];
+			auto& a = points[prev];
+			auto& b = points[cur];
+			auto& c = points[next];
+
+			if (cross2(a, b, c) * sign <= 0)
+				continue; // Reflex or degenerate corner.
+
+			// Only reflex vertices can be inside a convex corner.
+			bool ear = true;
+			for (size_t j = 0; j < m && ear; ++j) {
+				uint32_t k = remaining[j];
+				if (k == prev || k == cur || k == next)
+					continue;
+
+				auto& p = points[k];
+				auto& kp = points[remaining[(j + m - 1) % m]];
+				auto& kn = points[remaining[(j + 1) % m]];
+				if (cross2(kp, p, kn) * sign > 0)
+					continue;
+
+				if (in_triangle(p, a, b, c, sign))
+					ear = false;
+			}
+
+			if (!ear)
+				continue;
+
+			triangles.push_back({prev, cur, next});
+			remaining.erase(remaining.begin() + i);
+			clipped = true;
+			break;
+		}
+
+		if (!clipped)
+			return false;
+	}
+
+	triangles.push_back({remaining[0], remaining[1], remaining[2]});
+
+	return true;
+}
+
+// Distance from p to the line through a and b.
+static float line_distance(const Vector3<float>& p, const Vector3<float>& a,
+                           const Vector3<float>& b)
+{
+	Vector3<float> ab = b - a;
+	float len = length(ab);
+	if (len == 0)
+		return length(p - a);
+
+	return length(cross(ab, p - a)) / len;
+}
+
+// Returns the border of a region as a loop of vertex ids, or an empty
+// vector if the border isn't a single simple loop.
+static std::vector<uint32_t>
+region_border(const MDB_file::Walk_mesh& wm, const std::vector<uint32_t>& ids,
+              const std::vector<uint32_t>& region_faces,
+              const std::vector<uint32_t>& face_regions, uint32_t region,
+              const std::unordered_map<uint64_t, uint32_t>& edges)
+{
+	std::unordered_map<uint32_t, uint32_t> next;
+	size_t border_edges = 0;
+
+	for (uint32_t f : region_faces) {
+		auto& face = wm.faces[f];
+
+		for (uint32_t e = 0; e < 3; ++e) {
+			uint32_t a = ids[face.vertex_indices[e]];
+			uint32_t b = ids[face.vertex_indices[(e + 1) % 3]];
+
+			auto it = edges.find(half_edge_key(b, a));
+			if (it != edges.end() && face_regions[it->second / 3] == region)
+				continue; // Inner edge.
+
+			if (!next.try_emplace(a, b).second)
+				return {}; // Two border edges leave a.
+			++border_edges;
+		}
+	}
+
+	if (next.empty())
+		return {}; // No border at all.
+
+	std::vector<uint32_t> loop;
+	uint32_t start = next.begin()->first;
+	uint32_t v = start;
+
+	do {
+		loop.push_back(v);
+		auto it = next.find(v);
+		if (it == next.end() || loop.size() > border_edges)
+			return {};
+		v = it->second;
+	} while (v != start);
+
+	if (loop.size() != border_edges)
+		return {}; // More than one loop (the region has holes).
+
+	return loop;
+}
+
+size_t merge_coplanar_faces(MDB_file::Walk_mesh& walk_mesh,
+                            float normal_tolerance, float distance_tolerance)
+{
+	auto& wm = walk_mesh;
+	size_t face_count = wm.faces.size();
+
+	auto ids = position_ids(wm);
+	auto edges = half_edges(wm, ids);
+	auto adjacency = face_adjacency(wm, ids);
+
+	std::vector<Vector3<float>> normals(face_count);
+	for (size_t f = 0; f < face_count; ++f) {
+		auto& face = wm.faces[f];
+		if (!valid_face(wm, face))
+			continue;
+
+		auto& p0 = wm.verts[face.vertex_indices[0]].position;
+		auto& p1 = wm.verts[face.vertex_indices[1]].position;
+		auto& p2 = wm.verts[face.vertex_indices[2]].position;
+		normals[f] = normalize(cross(p1 - p0, p2 - p0));
+	}
+
+	// Grow regions of connected coplanar faces with the same flags. The
+	// plane of the first face is used for the whole region, so it doesn't
+	// drift along a gently curved surface.
+	const uint32_t no_region = UINT32_MAX;
+	std::vector<uint32_t> face_regions(face_count, no_region);
+	std::vector<std::vector<uint32_t>> regions;
+	float min_cos = std::cos(normal_tolerance);
+
+	for (uint32_t seed = 0; seed < face_count; ++seed) {
+		if (face_regions[seed] != no_region)
+			continue;
+
+		uint32_t region = uint32_t(regions.size());
+		regions.emplace_back();
+		auto& faces = regions.back();
+
+		face_regions[seed] = region;
+		faces.push_back(seed);
+
+		if (length(normals[seed]) == 0)
+			continue; // Invalid or degenerate faces stay alone.
+
+		auto& n = normals[seed];
+		auto& origin = wm.verts[wm.faces[seed].vertex_indices[0]].position;
+		auto& seed_face = wm.faces[seed];
+
+		for (size_t i = 0; i < faces.size(); ++i) {
+			for (uint32_t nb : adjacency[faces[i]]) {
+				if (nb == Walk_mesh_graph::no_face ||
+				    face_regions[nb] != no_region)
+					continue;
+
+				auto& face = wm.faces[nb];
+				if (face.flags[0] != seed_face.flags[0] ||
+				    face.flags[1] != seed_face.flags[1] ||
+				    dot(normals[nb], n) < min_cos)
+					continue;
+
+				bool coplanar = true;
+				for (int k = 0; k < 3; ++k) {
+					auto& p = wm.verts[face.vertex_indices[k]].position;
+					if (std::fabs(dot(p - origin, n)) >
+					    distance_tolerance)
+						coplanar = false;
+				}
+
+				if (!coplanar)
+					continue;
+
+				face_regions[nb] = region;
+				faces.push_back(nb);
+			}
+		}
+	}
+
+	// Vertices used by more than one region must be kept.
+	std::vector<uint32_t> vertex_regions(wm.verts.size(), no_region);
+	std::vector<bool> shared(wm.verts.size(), false);
+	for (uint32_t f = 0; f < face_count; ++f) {
+		auto& face = wm.faces[f];
+		if (!valid_face(wm, face))
+			continue;
+
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = ids[face.vertex_indices[k]];
+			if (vertex_regions[v] == no_region)
+				vertex_regions[v] = face_regions[f];
+			else if (vertex_regions[v] != face_regions[f])
+				shared[v] = true;
+		}
+	}
+
+	// New triangles of each merged region.
+	std::vector<std::vector<std::array<uint32_t, 3>>> merged(regions.size());
+	std::vector<bool> is_merged(regions.size(), false);
+
+	for (uint32_t r = 0; r < regions.size(); ++r) {
+		auto& faces = regions[r];
+		if (faces.size() < 2)
+			continue;
+
+		auto loop = region_border(wm, ids, faces, face_regions, r, edges);
+		if (loop.size() < 3)
+			continue;
+
+		// Another region can touch this one at a single vertex inside
+		// it. That vertex would disappear with the inner faces.
+		std::unordered_set<uint32_t> on_border(loop.begin(), loop.end());
+		bool keeps_shared = true;
+		for (uint32_t f : faces) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t v = ids[wm.faces[f].vertex_indices[k]];
+				if (shared[v] && !on_border.count(v))
+					keeps_shared = false;
+			}
+		}
+
+		if (!keeps_shared)
+			continue;
+
+		// Drop collinear border vertices that no other region uses.
+		bool removed = true;
+		while (removed && loop.size() > 3) {
+			removed = false;
+			for (size_t i = 0; i < loop.size() && loop.size() > 3; ++i) {
+				uint32_t v = loop[i];
+				if (shared[v])
+					continue;
+
+				auto& prev = wm.verts[loop[(i + loop.size() - 1) %
+				                           loop.size()]]
+				                 .position;
+				auto& next = wm.verts[loop[(i + 1) % loop.size()]]
+				                 .position;
+				if (line_distance(wm.verts[v].position, prev, next) <=
+				    distance_tolerance) {
+					loop.erase(loop.begin() + i);
+					removed = true;
+					--i;
+				}
+			}
+		}
+
+		if (loop.size() - 2 >= faces.size())
+			continue;
+
+		// Project on the plane of the dominant normal axis.
+		auto& n = normals[faces[0]];
+		int axis = std::fabs(n.x) > std::fabs(n.y)
+		               ? (std::fabs(n.x) > std::fabs(n.z) ? 0 : 2)
+		               : (std::fabs(n.y) > std::fabs(n.z) ? 1 : 2);
+
+		std::vector<Point2> points(loop.size());
+		for (size_t i = 0; i < loop.size(); ++i) {
+			auto& p = wm.verts[loop[i]].position;
+			points[i] = axis == 0   ? Point2{p.y, p.z}
+			            : axis == 1 ? Point2{p.z, p.x}
+			                        : Point2{p.x, p.y};
+		}
+
+		std::vector<std::array<uint32_t, 3>> triangles;
+		if (!triangulate(points, triangles))
+			continue;
+
+		for (auto& t : triangles)
+			for (auto& i : t)
+				i = loop[i];
+
+		merged[r] = std::move(triangles);
+		is_merged[r] = true;
+	}
+
+	// Rebuild the faces, emitting each merged region where its first
+	// face was.
+	std::vector<MDB_file::Walk_mesh_face> faces;
+	std::vector<bool> emitted(regions.size(), false);
+
+	for (uint32_t f = 0; f < face_count; ++f) {
+		uint32_t r = face_regions[f];
+		if (!is_merged[r]) {
+			faces.push_back(wm.faces[f]);
+			continue;
+		}
+
+		if (emitted[r])
+			continue;
+		emitted[r] = true;
+
+		for (auto& t : merged[r]) {
+			MDB_file::Walk_mesh_face face = wm.faces[f];
+			for (int k = 0; k < 3; ++k)
+				face.vertex_indices[k] = uint16_t(t[k]);
+			faces.push_back(face);
+		}
+	}
+
+	size_t removed_faces = face_count - faces.size();
+	wm.faces = std::move(faces);
+
+	// Remove the vertices no longer used.
+	const uint32_t unused = UINT32_MAX;
+	std::vector<uint32_t> remap(wm.verts.size(), unused);
+	for (auto& face : wm.faces) {
+		for (int k = 0; k < 3; ++k) {
+			if (face.vertex_indices[k] < wm.verts.size())
+				remap[face.vertex_indices[k]] = 0;
+		}
+	}
+
+	uint32_t next = 0;
+	for (uint32_t v = 0; v < wm.verts.size(); ++v) {
+		if (remap[v] == unused)
+			continue;
+
+		remap[v] = next;
+		wm.verts[next++] = wm.verts[v];
+	}
+	wm.verts.resize(next);
+
+	for (auto& face : wm.faces) {
+		for (int k = 0; k < 3; ++k) {
+			if (face.vertex_indices[k] < remap.size())
+				face.vertex_indices[k] =
+				    uint16_t(remap[face.vertex_indices[k]]);
+		}
+	}
+
+	return removed_faces;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "cgmath.h"
+#include "mdb_file.h"
+
+/// Connectivity of the faces of a walk mesh.
+///
+/// Vertices at the same position are treated as one, so faces connect even
+/// if the walk mesh has duplicated vertices.
+class Walk_mesh_graph {
+public:
+	/// Value of a neighbour when an edge is on the border of the mesh.
+	static const uint32_t no_face = UINT32_MAX;
+
+	/// Edge of the navigation graph.
+	struct Link {
+		uint32_t face;
+		/// Distance between the centers of both faces.
+		float cost;
+	};
+
+	Walk_mesh_graph(const MDB_file::Walk_mesh& walk_mesh);
+
+	/// Returns the faces across each edge of a face. Edge i goes from
+	/// vertex i to vertex (i + 1) % 3 of the face.
+	const std::array<uint32_t, 3>& neighbours(uint32_t face) const;
+
+	/// Returns the walkable faces reachable in one step from a walkable
+	/// face. Empty for faces that aren't walkable.
+	std::span<const Link> links(uint32_t face) const;
+
+	/// Returns the center of a face.
+	const Vector3<float>& center(uint32_t face) const;
+
+	/// Returns the number of faces.
+	size_t face_count() const;
+
+private:
+	std::vector<std::array<uint32_t, 3>> adjacency;
+	std::vector<Vector3<float>> centers;
+	/// Links of face f are link_list[link_offsets[f], link_offsets[f + 1]).
+	std::vector<uint32_t> link_offsets;
+	std::vector<Link> link_list;
+};
+
+/// Merges connected coplanar faces with the same flags into fewer
+/// triangles.
+///
+/// Each region of such faces is retriangulated from its border when the
+/// border is a single simple loop. Vertices inside the region disappear,
+/// and so do collinear border vertices not used by any other face, so the
+/// mesh stays free of T-junctions. Regions with holes, and regions with a
+/// vertex inside them used by another face, are kept as they are. Unused
+/// vertices are removed afterwards.
+///
+/// @param walk_mesh The walk mesh to simplify.
+/// @param normal_tolerance Maximum angle between face normals, in radians.
+/// @param distance_tolerance Maximum distance of a vertex to the plane of
+/// the region.
+/// @return Number of faces removed.
+size_t merge_coplanar_faces(MDB_file::Walk_mesh& walk_mesh,
+                            float normal_tolerance = 0.001f,
+                            float distance_tolerance = 0.001f);
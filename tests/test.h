@@ -0,0 +1,21 @@
+#pragma once
+
+#include <iostream>
+
+/// Number of checks that have failed.
+extern int test_failures;
+
+/// Checks a condition, reporting it with its location if it's false.
+#define CHECK(condition)                                                       \
+	do {                                                                   \
+		if (!(condition)) {                                            \
+			std::cout << __FILE__ << ":" << __LINE__               \
+			          << ": check failed: " #condition "\n";       \
+			++test_failures;                                       \
+		}                                                              \
+	} while (0)
+
+void test_archive_container();
+void test_mdb_view();
+void test_mesh_bvh();
+void test_vertex_welder();
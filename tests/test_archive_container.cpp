@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "archive_container.h"
+#include "test.h"
+
+namespace fs = std::filesystem;
+
+// Contents of the test file i. Odd files are stored, even files deflated.
+static std::vector<unsigned char> file_contents(unsigned i)
+{
+	std::vector<unsigned char> data(1000 + i * 300);
+	for (size_t j = 0; j < data.size(); ++j)
+		data[j] = (unsigned char)(j % (i + 7) + 'a');
+
+	return data;
+}
+
+static std::string file_name(unsigned i)
+{
+	return "file" + std::to_string(i) + ".mdb";
+}
+
+static bool write_test_zip(const std::string& filename, unsigned file_count)
+{
+	mz_zip_archive zip;
+	mz_zip_zero_struct(&zip);
+	if (!mz_zip_writer_init_file(&zip, filename.c_str(), 0))
+		return false;
+
+	bool ok = true;
+	for (unsigned i = 0; i < file_count; ++i) {
+		auto data = file_contents(i);
+		ok = ok && mz_zip_writer_add_mem(&zip, file_name(i).c_str(),
+		                                 data.data(), data.size(),
+		                                 i % 2 ? MZ_NO_COMPRESSION
+		                                       : MZ_DEFAULT_LEVEL);
+	}
+
+	ok = mz_zip_writer_finalize_archive(&zip) && ok;
+	mz_zip_writer_end(&zip);
+
+	return ok;
+}
+
+static bool equal(std::span<const unsigned char> data,
+                  const std::vector<unsigned char>& expected)
+{
+	return std::equal(data.begin(), data.end(), expected.begin(),
+	                  expected.end());
+}
+
+static void test_extraction_context(const Archive_container& archives,
+                                    unsigned file_count)
+{
+	Archive_container::Extraction_context context;
+
+	// The last deflated file is the biggest one, so the output buffer of
+	// the context doesn't grow after it.
+	std::span<const unsigned char> data;
+	CHECK(archives.file_view(0, file_count - 2, data, context));
+	auto buffer = data.data();
+
+	std::vector<unsigned char> extracted;
+
+	for (unsigned i = 0; i < file_count; ++i) {
+		auto expected = file_contents(i);
+
+		CHECK(archives.file_view(0, i, data, context));
+		CHECK(equal(data, expected));
+
+		// Deflated files are inflated into the same buffer.
+		if (i % 2 == 0)
+			CHECK(data.data() == buffer);
+
+		CHECK(archives.extract_file_to_mem(0, i, extracted, context));
+		CHECK(extracted == expected);
+	}
+
+	CHECK(!archives.file_view(0, file_count, data, context));
+	CHECK(!archives.file_view(1, 0, data, context));
+}
+
+static void test_concurrent_views(const Archive_container& archives,
+                                  unsigned file_count)
+{
+	// The threads map the archive at the same time on their first view.
+	std::vector<std::thread> threads;
+	std::vector<char> ok(4, true);
+
+	for (size_t t = 0; t < ok.size(); ++t) {
+		threads.emplace_back([&, t] {
+			Archive_container::Extraction_context context;
+			for (unsigned i = 0; i < file_count; ++i) {
+				std::span<const unsigned char> data;
+				if (!archives.file_view(0, i, data, context) ||
+				    !equal(data, file_contents(i)))
+					ok[t] = false;
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto b : ok)
+		CHECK(b);
+}
+
+void test_archive_container()
+{
+	const unsigned file_count = 20;
+	auto filename =
+	    (fs::temp_directory_path() / "nwn2mdk_test.zip").string();
+
+	CHECK(write_test_zip(filename, file_count));
+
+	{
+		Archive_container archives;
+		CHECK(archives.add_archive(filename.c_str()));
+		CHECK(archives.file_count(0) == file_count);
+
+		test_extraction_context(archives, file_count);
+	}
+
+	{
+		Archive_container archives;
+		CHECK(archives.add_archive(filename.c_str()));
+
+		test_concurrent_views(archives, file_count);
+	}
+
+	std::error_code ec;
+	fs::remove(filename, ec);
+}
@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "mdb_file.h"
+#include "mdb_view.h"
+#include "test.h"
+
+// Builds a MDB with a rigid mesh, a walk mesh, collision spheres and a
+// hook.
+static std::vector<unsigned char> sample_mdb()
+{
+	MDB_file mdb;
+
+	auto rm = std::make_unique<MDB_file::Rigid_mesh>();
+	for (int i = 0; i < 5; ++i) {
+		MDB_file::Rigid_mesh_vertex v{};
+		v.position = Vector3<float>(float(i), float(i * 2), float(i * 3));
+		rm->verts.push_back(v);
+	}
+	rm->faces.push_back({{0, 1, 2}});
+	rm->faces.push_back({{2, 3, 4}});
+	rm->faces.push_back({{4, 3, 0}});
+	mdb.add_packet(std::move(rm));
+
+	auto wm = std::make_unique<MDB_file::Walk_mesh>();
+	for (int i = 0; i < 3; ++i)
+		wm->verts.push_back({Vector3<float>(float(i), 2, 3)});
+	MDB_file::Walk_mesh_face face{};
+	face.vertex_indices[1] = 1;
+	face.vertex_indices[2] = 2;
+	face.flags[0] = 9;
+	wm->faces.push_back(face);
+	mdb.add_packet(std::move(wm));
+
+	auto cs = std::make_unique<MDB_file::Collision_spheres>();
+	cs->spheres.push_back({3, 0.5f});
+	cs->spheres.push_back({7, 1.5f});
+	cs->header.sphere_count = 2;
+	mdb.add_packet(std::move(cs));
+
+	auto hook = std::make_unique<MDB_file::Hook>();
+	hook->header.position = Vector3<float>(1, 2, 3);
+	mdb.add_packet(std::move(hook));
+
+	return mdb.save_to_mem();
+}
+
+// Moves the packets of a MDB by some bytes, so they start at offsets with
+// any alignment.
+static std::vector<unsigned char> shift_packets(std::vector<unsigned char> data,
+                                                uint32_t shift)
+{
+	const size_t header_size = 12;
+	const size_t key_size = 8;
+
+	uint32_t packet_count;
+	memcpy(&packet_count, data.data() + 8, 4);
+
+	size_t packets_begin = header_size + key_size * packet_count;
+	data.insert(data.begin() + packets_begin, shift, 0);
+
+	for (uint32_t i = 0; i < packet_count; ++i) {
+		auto p = data.data() + header_size + key_size * i + 4;
+		uint32_t offset;
+		memcpy(&offset, p, 4);
+		offset += shift;
+		memcpy(p, &offset, 4);
+	}
+
+	return data;
+}
+
+static void test_unaligned_packets(uint32_t shift)
+{
+	auto data = shift_packets(sample_mdb(), shift);
+
+	// Check an odd start of the buffer too.
+	std::vector<unsigned char> storage(data.size() + 1);
+	memcpy(storage.data() + 1, data.data(), data.size());
+
+	MDB_view view(storage.data() + 1, data.size());
+	CHECK(view);
+	CHECK(view.packet_count() == 4);
+
+	auto rm = view.rigid_mesh(0);
+	CHECK(rm);
+	CHECK(rm.header.vertex_count == 5);
+	CHECK(rm.verts.size() == 5);
+	CHECK(rm.faces.size() == 3);
+	CHECK(rm.verts[4].position.z == 12);
+	CHECK(rm.faces[2].vertex_indices[0] == 4);
+	CHECK(rm.verts.bytes().size() ==
+	      5 * sizeof(MDB_file::Rigid_mesh_vertex));
+
+	float sum = 0;
+	for (auto v : rm.verts)
+		sum += v.position.y;
+	CHECK(sum == 20);
+
+	CHECK(!view.rigid_mesh(1));
+
+	auto wm = view.walk_mesh(1);
+	CHECK(wm);
+	CHECK(wm.faces.size() == 1);
+	CHECK(wm.faces[0].flags[0] == 9);
+	CHECK(wm.verts[2].position.x == 2);
+
+	auto spheres = view.collision_spheres(2);
+	CHECK(spheres.size() == 2);
+	CHECK(spheres[1].bone_index == 7);
+	CHECK(spheres[1].radius == 1.5f);
+	CHECK(view.collision_spheres(0).empty());
+
+	MDB_file::Hook_header hook;
+	CHECK(view.hook(3, hook));
+	CHECK(hook.position.y == 2);
+	CHECK(!view.hook(0, hook));
+
+	// MDB_file validates buffers with MDB_view, so it must accept the
+	// same data.
+	MDB_file mdb(storage.data() + 1, data.size());
+	CHECK(mdb);
+	CHECK(mdb.packet_count() == 4);
+}
+
+static void test_truncated()
+{
+	auto data = sample_mdb();
+
+	MDB_view view(data.data(), data.size() - 1);
+	CHECK(!view);
+
+	MDB_view owned(std::move(data));
+	CHECK(owned);
+}
+
+void test_mdb_view()
+{
+	for (uint32_t shift = 0; shift < 4; ++shift)
+		test_unaligned_packets(shift);
+
+	test_truncated();
+}
@@ -0,0 +1,65 @@
+#include "mesh_bvh.h"
+#include "test.h"
+
+// Flat walk mesh of n x n unit squares, two walkable faces each, with
+// its own vertices per face as in exported models.
+static MDB_file::Walk_mesh grid_walk_mesh(int n)
+{
+	MDB_file::Walk_mesh wm;
+
+	auto add_face = [&](Vector3<float> a, Vector3<float> b,
+	                    Vector3<float> c) {
+		Vector3<float> corners[3] = {a, b, c};
+		MDB_file::Walk_mesh_face face{};
+		for (int k = 0; k < 3; ++k) {
+			MDB_file::Walk_mesh_vertex v{};
+			v.position = corners[k];
+			face.vertex_indices[k] = uint16_t(wm.verts.size());
+			wm.verts.push_back(v);
+		}
+		face.flags[0] = 0x01;
+		wm.faces.push_back(face);
+	};
+
+	for (int j = 0; j < n; ++j) {
+		for (int i = 0; i < n; ++i) {
+			Vector3<float> a(float(i), float(j), 0);
+			Vector3<float> b(float(i + 1), float(j), 0);
+			Vector3<float> c(float(i + 1), float(j + 1), 0);
+			Vector3<float> d(float(i), float(j + 1), 0);
+			add_face(a, b, c);
+			add_face(a, c, d);
+		}
+	}
+
+	return wm;
+}
+
+static void test_face_at_edges(int n)
+{
+	// Points on the vertices, the shared edges and the border of the mesh
+	// lie on the bounds of BVH nodes, where the vertical ray is parallel
+	// to their x or y slabs.
+	Mesh_bvh bvh(grid_walk_mesh(n));
+
+	int misses = 0;
+	for (int j = 0; j <= 2 * n; ++j) {
+		for (int i = 0; i <= 2 * n; ++i) {
+			if (!bvh.face_at(i * 0.5f, j * 0.5f))
+				++misses;
+		}
+	}
+
+	CHECK(misses == 0);
+
+	CHECK(bvh.face_at(0.3f, 0));
+	CHECK(bvh.face_at(float(n), 0.7f));
+	CHECK(!bvh.face_at(-0.5f, 0.5f));
+	CHECK(!bvh.face_at(0.5f, float(n) + 0.5f));
+}
+
+void test_mesh_bvh()
+{
+	test_face_at_edges(2);
+	test_face_at_edges(16);
+}
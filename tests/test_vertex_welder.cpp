@@ -0,0 +1,58 @@
+#include "test.h"
+#include "vertex_welder.h"
+
+static void test_exact()
+{
+	MDB_file::Rigid_mesh mesh;
+	Vertex_welder<MDB_file::Rigid_mesh_vertex> welder;
+
+	MDB_file::Rigid_mesh_vertex v1{}, v2{};
+	v2.position.x = 1;
+
+	CHECK(welder.push(mesh.verts, v1) == 0);
+	CHECK(welder.push(mesh.verts, v2) == 1);
+	CHECK(welder.push(mesh.verts, v1) == 0);
+	CHECK(mesh.verts.size() == 2);
+}
+
+static void test_signed_zero()
+{
+	// Normals and UVs exported from FBX often have -0 where others have
+	// +0. They compare equal, so the vertices must be welded.
+	MDB_file::Rigid_mesh mesh;
+	Vertex_welder<MDB_file::Rigid_mesh_vertex> welder;
+
+	MDB_file::Rigid_mesh_vertex v1{}, v2{};
+	v1.normal = Vector3<float>(0.0f, 0.0f, 1.0f);
+	v2.normal = Vector3<float>(-0.0f, -0.0f, 1.0f);
+	v2.uvw.x = -0.0f;
+
+	CHECK(welder.push(mesh.verts, v1) == 0);
+	CHECK(welder.push(mesh.verts, v2) == 0);
+	CHECK(mesh.verts.size() == 1);
+}
+
+static void test_epsilon()
+{
+	MDB_file::Walk_mesh mesh;
+	Vertex_welder<MDB_file::Walk_mesh_vertex> welder(0.001f);
+
+	MDB_file::Walk_mesh_vertex v1{}, v2{}, v3{};
+	v1.position.x = 1.00001f;
+	v2.position.x = 1.0f;
+	v3.position.x = 1.1f;
+
+	CHECK(welder.push(mesh.verts, v1) == 0);
+	CHECK(welder.push(mesh.verts, v2) == 0);
+	CHECK(welder.push(mesh.verts, v3) == 1);
+
+	// The first vertex of a cell is the one kept.
+	CHECK(mesh.verts[0].position.x == 1.00001f);
+}
+
+void test_vertex_welder()
+{
+	test_exact();
+	test_signed_zero();
+	test_epsilon();
+}
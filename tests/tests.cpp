@@ -0,0 +1,19 @@
+#include "test.h"
+
+int test_failures = 0;
+
+int main()
+{
+	test_archive_container();
+	test_mdb_view();
+	test_mesh_bvh();
+	test_vertex_welder();
+
+	if (test_failures > 0) {
+		std::cout << test_failures << " checks failed\n";
+		return 1;
+	}
+
+	std::cout << "All tests passed\n";
+	return 0;
+}